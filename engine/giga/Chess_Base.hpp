@@ -764,7 +764,7 @@ static std::string _map(uint64_t val1, uint64_t val2, const Board& val3, const B
 /// Call this via _func(brd)
 /// </summary>
 #define PositionToTemplate(func) \
-static inline float _##func(std::string_view pos, int depth, float alpha, float beta, ChessNet &model, std::unordered_map<uint64_t, float> &evaluations_map) { \
+static inline float _##func(std::string_view pos, int depth, float alpha, float beta, ChessNet &model, EvalCache &evaluations_map) { \
 const bool WH = FEN::FenInfo<FenField::white>(pos);\
 const bool EP = FEN::FenInfo<FenField::hasEP>(pos);\
 const bool BL = FEN::FenInfo<FenField::BCastleL>(pos);\
@@ -9,12 +9,24 @@
 #include <cstdlib> // For rand()
 #include <ctime>   // For time()
 #include <unordered_map>
+#include <type_traits>
 
 #include "Movelist.hpp"
 #include "Chess_Test.hpp"
 #include "../../training/include/chessnet.h"
+#include "../../training/include/conv_inference.h"
+#include "../../training/include/int8_inference.h"
+#include "../../training/include/nnue_inference.h"
+#include "../../training/include/board_encoding.h"
+#include "../../training/include/frozen_model.h"
 #include "../include/data_preparation.h"
 #include "../include/zorbist.hpp"
+#include "../include/transposition.hpp"
+#include "../include/eval_cache.hpp"
+#include "../include/search_control.hpp"
+#include "../include/tablebase.h"
+#include "../include/syzygy.h"
+#include "../include/kpk_bitbase.hpp"
 
 ChessPosition createChessPosition(const Board &board,
 								  const BoardStatus &status,
@@ -97,23 +109,125 @@ ChessPosition createChessPosition(const Board &board,
 class MoveReceiver
 {
 public:
-	static inline uint64_t nodes;
-	static inline ChessNet model;
-	static inline std::unordered_map<uint64_t, float> *evaluations_map;
-	static inline std::vector<torch::Tensor> inputs;
+	// Per thread, so several searches can run at once (each with its own cache and session)
+	static inline thread_local uint64_t nodes;
+	static inline thread_local ChessNet model{nullptr};
+	static inline thread_local EvalCache *evaluations_map; // Shared by the threads of a search
+	static inline thread_local std::vector<torch::Tensor> inputs;
+	static inline thread_local TranspositionTable *transposition_table = nullptr; // Owned by the SearchSession, kept between moves
+	static inline thread_local SearchControl *control = nullptr; // Cancellation token of the running search, nullptr if it cannot be stopped
+	static inline thread_local uint32_t poll_counter = 0;
+	static inline const ConvInference::Network *cpu_network = nullptr; // Folded copy of the model for libtorch free inference, process wide
+	static inline const Int8Inference::Network *int8_network = nullptr; // Quantized copy of the model, preferred over cpu_network, process wide
+	static inline torch::jit::Module *frozen_model = nullptr; // Folded TorchScript copy of the model for the libtorch path, process wide
+	static inline const NNUEInference::Network *nnue_network = nullptr; // Replaces the model and the evaluation cache when set, process wide
+	static inline thread_local NNUEInference::Accumulator accumulators[32]; // NNUE accumulator of the board at each depth, like Movestack
+	static inline thread_local std::vector<ConvInference::Accumulator> conv_accumulators; // conv1 of the board at each depth when cpu_network evaluates the leaves
+	static inline thread_local uint64_t conv_pieces[32][12]; // Pieces of the board at each depth, what conv_accumulators catch up to
+	static inline thread_local int conv_valid = 0; // conv_accumulators[conv_valid] and above match the boards of the current line
+	static constexpr uint32_t POLL_INTERVAL = 2048; // Interior nodes between two deadline checks, power of two
+
+	// Pieces in NNUEInference order
+	static _ForceInline void nnuePieces(const Board &brd, uint64_t pieces[12])
+	{
+		pieces[0] = brd.WPawn;
+		pieces[1] = brd.WKnight;
+		pieces[2] = brd.WBishop;
+		pieces[3] = brd.WRook;
+		pieces[4] = brd.WQueen;
+		pieces[5] = brd.WKing;
+		pieces[6] = brd.BPawn;
+		pieces[7] = brd.BKnight;
+		pieces[8] = brd.BBishop;
+		pieces[9] = brd.BRook;
+		pieces[10] = brd.BQueen;
+		pieces[11] = brd.BKing;
+	}
+
+	// Both perspectives of an accumulator from the pieces on the board
+	static void nnueRefresh(const NNUEInference::Network &network, const Board &brd, NNUEInference::Accumulator &accumulator)
+	{
+		uint64_t pieces[12];
+		nnuePieces(brd, pieces);
+		network.refresh(accumulator, pieces, NNUEInference::WHITE);
+		network.refresh(accumulator, pieces, NNUEInference::BLACK);
+	}
+
+	// The float network's leaves start from the conv1 accumulator (the int8 and NNUE ones take precedence)
+	static _ForceInline bool convAccumulated()
+	{
+		return cpu_network != nullptr && int8_network == nullptr && nnue_network == nullptr;
+	}
+
+	// Accumulators of the root, every deeper one follows from them move by move
+	static _ForceInline void accumulateRoot(const Board &brd, int depth)
+	{
+		if (nnue_network != nullptr)
+		{
+			nnueRefresh(*nnue_network, brd, accumulators[depth]);
+		}
+		else if (convAccumulated())
+		{
+			if (conv_accumulators.size() < 32)
+			{
+				conv_accumulators.resize(32);
+			}
+			nnuePieces(brd, conv_pieces[depth]);
+			cpu_network->refresh(conv_accumulators[depth], conv_pieces[depth], ConvInference::WHITE);
+			cpu_network->refresh(conv_accumulators[depth], conv_pieces[depth], ConvInference::BLACK);
+			conv_valid = depth;
+		}
+	}
 
-	static _ForceInline void Init(Board &brd, uint64_t EPInit, ChessNet trained_model, std::unordered_map<uint64_t, float> &map)
+	// Accumulators after a move: the pieces the move removed and added (NNUE refreshes after a king move).
+	// conv1 only records the board: most leaves are answered by the evaluation cache or the
+	// transposition table, accumulatedForward brings the line up to date when the network runs
+	template <int depth>
+	static _ForceInline void accumulatePlayed(const Board &brd, const Board &next)
+	{
+		if (nnue_network != nullptr)
+		{
+			uint64_t before[12], after[12];
+			nnuePieces(brd, before);
+			nnuePieces(next, after);
+			nnue_network->update(accumulators[depth], accumulators[depth - 1], before, after);
+		}
+		else if (convAccumulated())
+		{
+			nnuePieces(next, conv_pieces[depth - 1]);
+			conv_valid = std::max(conv_valid, depth);
+		}
+	}
+
+	static _ForceInline void Init(Board &brd, uint64_t EPInit, ChessNet trained_model, EvalCache &map)
 	{
 		MoveReceiver::nodes = 0;
 		MoveReceiver::model = trained_model;
 		MoveReceiver::evaluations_map = &map;
-		if (torch::cuda::is_available())
+		// Callers move the model once before any search starts, moving a module that other threads
+		// are reading from is a race
+		if (torch::cuda::is_available() && !model->parameters().front().device().is_cuda())
 		{
 			model->to(torch::kCUDA);
-			// model->to(torch::kCPU);
 		}
 		Movelist::Init(EPInit);
-		initZobristKeys();
+		static const bool zobrist_ready = (initZobristKeys(), true); // Once, other threads may be hashing
+		(void)zobrist_ready;
+	}
+
+	// Polled by Movelist::EnumerateMoves on every interior node. The stop flag is read every time,
+	// the clock only every POLL_INTERVAL nodes and after every network forward pass.
+	static _ForceInline bool Stopped()
+	{
+		if (control == nullptr)
+		{
+			return false;
+		}
+		if ((++poll_counter & (POLL_INTERVAL - 1)) == 0)
+		{
+			return control->check_deadline();
+		}
+		return control->stopped();
 	}
 
 	template <class BoardStatus status>
@@ -144,20 +258,154 @@ public:
 		return h;
 	}
 
+	// King and pawn against king from the embedded bitbase, white's view. A win scores like a
+	// Syzygy win: above the network's range, below a mate on the board.
+	static constexpr float KPK_WIN = 1.02f;
+
+	template <class BoardStatus status>
+	static _ForceInline bool kpkValue(Board &brd, float &value)
+	{
+		if (Bitcount(brd.Occ) != 3 || Bitcount(brd.WPawn | brd.BPawn) != 1)
+		{
+			return false;
+		}
+		const bool white_pawn = brd.WPawn != 0;
+		// Gigantua counts the files from h, the bitbase from a; black pawns are seen from black's side
+		const int flip = white_pawn ? 7 : 63;
+		const int strong_king = static_cast<int>(SquareOf(white_pawn ? brd.WKing : brd.BKing)) ^ flip;
+		const int weak_king = static_cast<int>(SquareOf(white_pawn ? brd.BKing : brd.WKing)) ^ flip;
+		const int pawn = static_cast<int>(SquareOf(brd.WPawn | brd.BPawn)) ^ flip;
+
+		if (!KPK::probe(status.WhiteMove == white_pawn, strong_king, pawn, weak_king))
+		{
+			value = 0.0f;
+		}
+		else
+		{
+			value = white_pawn ? KPK_WIN : -KPK_WIN;
+		}
+		return true;
+	}
+
 	template <class BoardStatus status>
 	static _ForceInline float evaluate(Board &brd)
 	{
-		// 1. Generate a unique key for the current position
-		uint64_t key = computeZobristHash(brd, status, Movelist::EnPassantTarget);
+		// 0. King and pawn against king is solved, no need for the network
+		float kpk_value;
+		if (kpkValue<status>(brd, kpk_value))
+		{
+			return kpk_value;
+		}
 
-		// 2. Check if we have a cached evaluation for this position
-		auto it = evaluations_map->find(key);
-		if (it != evaluations_map->end())
+		// NNUE: the accumulator of the leaf is already up to date, evaluating costs less than a cache probe
+		if (nnue_network != nullptr)
 		{
-			return it->second;
+			float nnue_value = nnue_network->evaluate(accumulators[0], status.WhiteMove);
+			return status.WhiteMove ? nnue_value : -nnue_value;
 		}
 
+		// 1. Key of the position as the network sees it: with black to move the board is mirrored
+		//    and the colours swapped, so a position and its colour mirror image share one entry
 		ChessPosition position = createChessPosition(brd, status, Movelist::EnPassantTarget);
+		uint64_t key = computeCanonicalHash(position);
+
+		// 2. Check if we have a cached evaluation for this position (side to move's view, like the network)
+		float eval_value;
+		if (!evaluations_map->probe(key, eval_value))
+		{
+			eval_value = convAccumulated() ? accumulatedForward<status>() : forward(position);
+			evaluations_map->store(key, eval_value, EvalCache::signature(brd.Occ, brd.WPawn, brd.BPawn));
+		}
+
+		if (!status.WhiteMove)
+		{
+			eval_value *= -1;
+		}
+		return eval_value;
+	}
+
+	// The 13 input planes of the convolutional networks, as their toTensor
+	static _ForceInline void encodePlanes(const ChessPosition &position, float *planes)
+	{
+		const uint64_t bitboards[BoardEncoding::BITBOARDS] = {
+			position.WPawn, position.WKnight, position.WBishop, position.WRook, position.WQueen, position.WKing,
+			position.BPawn, position.BKnight, position.BBishop, position.BRook, position.BQueen, position.BKing,
+			position.EnPassant};
+		BoardEncoding::planes(bitboards, planes);
+	}
+
+	// Output of the folded network for a normalized position, the same as model->forward
+	static _ForceInline float cpuForward(const ConvInference::Network &network, const ChessPosition &position)
+	{
+		alignas(64) float planes[BoardEncoding::PLANES_SIZE];
+		encodePlanes(position, planes);
+		return network.forward(planes);
+	}
+
+	// The same from the conv1 accumulator of the leaf, conv1 is not computed again. The accumulators
+	// below the last one up to date follow the recorded boards first
+	template <class BoardStatus status>
+	static _ForceInline float accumulatedForward()
+	{
+		for (; conv_valid > 0; conv_valid--)
+		{
+			cpu_network->update(conv_accumulators[conv_valid], conv_accumulators[conv_valid - 1],
+								conv_pieces[conv_valid], conv_pieces[conv_valid - 1]);
+		}
+		float eval_value = cpu_network->forward(conv_accumulators[0], status.WhiteMove, Movelist::EnPassantTarget);
+		if (control != nullptr)
+		{
+			control->check_deadline();
+		}
+		return eval_value;
+	}
+
+	// cpuForward through a freshly refreshed conv1 accumulator (normalized position: white's view)
+	static float cpuAccumulatedForward(const ConvInference::Network &network, const ChessPosition &position)
+	{
+		thread_local ConvInference::Accumulator accumulator;
+		const uint64_t pieces[12] = {
+			position.WPawn, position.WKnight, position.WBishop, position.WRook, position.WQueen, position.WKing,
+			position.BPawn, position.BKnight, position.BBishop, position.BRook, position.BQueen, position.BKing};
+		network.refresh(accumulator, pieces, ConvInference::WHITE);
+		return network.forward(accumulator, true, position.EnPassant);
+	}
+
+	// Output of the quantized network for a normalized position, close to model->forward
+	static _ForceInline float int8Forward(const Int8Inference::Network &network, const ChessPosition &position)
+	{
+		if constexpr (std::is_same_v<ChessNet, ChessNetLinear>)
+		{
+			// ChessNetLinearImpl::toTensor: 1 for own pieces and en passant, -1 for the opponent's, then castling and side
+			const uint64_t bitboards[BoardEncoding::BITBOARDS] = {
+				position.WPawn, position.WKnight, position.WBishop, position.WRook, position.WQueen, position.WKing,
+				position.BPawn, position.BKnight, position.BBishop, position.BRook, position.BQueen, position.BKing,
+				position.EnPassant};
+			const bool flags[5] = {position.MyCastleL, position.MyCastleR, position.EnemyCastleL, position.EnemyCastleR, position.WhiteMove};
+			alignas(64) float features[BoardEncoding::FEATURES_SIZE];
+			BoardEncoding::features(bitboards, flags, features);
+			return network.forward(features);
+		}
+		else
+		{
+			alignas(64) float planes[BoardEncoding::PLANES_SIZE];
+			encodePlanes(position, planes);
+			return network.forward(planes);
+		}
+	}
+
+	// Network output for a normalized position, from the side to move
+	static _ForceInline float forward(const ChessPosition &position)
+	{
+		if (int8_network != nullptr || cpu_network != nullptr)
+		{
+			float eval_value = int8_network != nullptr ? int8Forward(*int8_network, position) : cpuForward(*cpu_network, position);
+			if (control != nullptr)
+			{
+				control->check_deadline();
+			}
+			return eval_value;
+		}
 
 		torch::Tensor positionINTensor = model->toTensor(position);
 
@@ -167,16 +415,25 @@ public:
 			positionINTensor = positionINTensor.to(torch::kCUDA);
 		}
 
-		// Perform the forward pass with the model
-		torch::Tensor output = model->forward(positionINTensor);
+		// Perform the forward pass with the model, or its frozen copy when there is one
+		torch::Tensor output;
+		if (frozen_model != nullptr)
+		{
+			c10::InferenceMode inference;
+			output = frozen_model->forward({positionINTensor}).toTensor();
+		}
+		else
+		{
+			output = model->forward(positionINTensor);
+		}
 
 		float eval_value = output.item<float>();
 
-		if (!status.WhiteMove)
+		// A forward pass costs far more than reading the clock
+		if (control != nullptr)
 		{
-			eval_value *= -1;
+			control->check_deadline();
 		}
-		(*evaluations_map)[key] = eval_value;
 
 		return eval_value;
 	}
@@ -202,10 +459,64 @@ public:
 		}
 	}
 
+	// Value of an ending from the tablebases, white's view like the network. A forced mate from the
+	// distance to mate tables scores between 1 and the 1.1 of a mate on the board, the shorter the
+	// higher; a Syzygy win (no distance) scores just above 1. Castling and en passant are not in the tables.
+	static constexpr float SYZYGY_WIN = 1.02f;
+
+	template <class BoardStatus status>
+	static _ForceInline bool tablebaseValue(Board &brd, float &value)
+	{
+		if constexpr (status.HasEPPawn || status.WCastleL || status.WCastleR || status.BCastleL || status.BCastleR)
+		{
+			return false;
+		}
+		else
+		{
+			const int piece_count = static_cast<int>(Bitcount(brd.Occ));
+			const bool own_tables = piece_count <= TB_MAX_PIECES && tablebasesLoaded();
+			if (!own_tables && piece_count > syzygyProbeLimit())
+			{
+				return false;
+			}
+			const uint64_t pieces[12] = {brd.BPawn, brd.BKnight, brd.BBishop, brd.BRook, brd.BQueen, brd.BKing,
+										 brd.WPawn, brd.WKnight, brd.WBishop, brd.WRook, brd.WQueen, brd.WKing};
+			TBResult result;
+			int wdl;
+			if (own_tables && probeTablebase(pieces, status.WhiteMove, result))
+			{
+				value = result.wdl * (1.1f - 0.0005f * result.moves);
+			}
+			else if (piece_count <= syzygyProbeLimit() && probeSyzygyWdl(pieces, status.WhiteMove, wdl))
+			{
+				value = wdl * SYZYGY_WIN;
+			}
+			else
+			{
+				return false;
+			}
+			if constexpr (!status.WhiteMove)
+			{
+				value = -value;
+			}
+			return true;
+		}
+	}
+
 	template <class BoardStatus status>
 	static _ForceInline float PerfT0(Board &brd)
 	{
+		// The value of a stopped search is thrown away by the root, skip the remaining leaves
+		if (control != nullptr && control->stopped())
+		{
+			return 0;
+		}
 		nodes++;
+		float tablebase_value;
+		if (tablebaseValue<status>(brd, tablebase_value))
+		{
+			return tablebase_value; // no network call for a known ending
+		}
 		float eval = evaluate<status>(brd);
 		return eval;
 	}
@@ -230,7 +541,57 @@ public:
 		}
 		else
 		{
-			return Movelist::EnumerateMoves<status, MoveReceiver, depth>(brd, alpha, beta);
+			// Known endings are exact, nothing to search below them
+			float tablebase_value;
+			if (tablebaseValue<status>(brd, tablebase_value))
+			{
+				nodes++;
+				return tablebase_value;
+			}
+
+			if (transposition_table == nullptr)
+			{
+				return Movelist::EnumerateMoves<status, MoveReceiver, depth>(brd, alpha, beta);
+			}
+
+			// 1. Probe the transposition table, a result of equal or greater depth can end the search here
+			uint64_t key = computeZobristHash(brd, status, Movelist::EnPassantTarget);
+			TTEntry entry;
+			Movestack::Hash_Move[depth] = 0;
+			if (transposition_table->probe(key, entry))
+			{
+				if (entry.depth >= depth)
+				{
+					if (entry.bound == TT_EXACT ||
+						(entry.bound == TT_LOWER && entry.value >= beta) ||
+						(entry.bound == TT_UPPER && entry.value <= alpha))
+					{
+						return entry.value;
+					}
+				}
+				// 2. Otherwise the stored move is searched first
+				Movestack::Hash_Move[depth] = entry.best_move;
+			}
+
+			// 3. Search and store the result with its bound
+			Movestack::Best_Move[depth] = 0;
+			float value = Movelist::EnumerateMoves<status, MoveReceiver, depth>(brd, alpha, beta);
+			if (control != nullptr && control->stopped())
+			{
+				return value; // Incomplete, must not be stored
+			}
+
+			TTBound bound = TT_EXACT;
+			if (value <= alpha)
+			{
+				bound = TT_UPPER;
+			}
+			else if (value >= beta)
+			{
+				bound = TT_LOWER;
+			}
+			transposition_table->store(key, value, Movestack::Best_Move[depth], depth, bound);
+			return value;
 		}
 	}
 
@@ -243,6 +604,7 @@ public:
 	static float Kingmove(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::King, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Kingmove:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -261,6 +623,7 @@ public:
 	static float KingCastle(const Board &brd, uint64_t kingswitch, uint64_t rookswitch, float alpha, float beta)
 	{
 		Board next = Board::MoveCastle<status.WhiteMove>(brd, kingswitch, rookswitch);
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "KingCastle:\n"
 						<< _map(kingswitch, rookswitch, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, false);
@@ -291,6 +654,7 @@ public:
 	static float Pawnmove(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, false>(brd, from, to);
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Pawnmove:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -306,6 +670,7 @@ public:
 	static float Pawnatk(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, true>(brd, from, to);
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Pawntake:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -328,6 +693,7 @@ public:
 	static float PawnEnpassantTake(const Board &brd, uint64_t from, uint64_t enemy, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::MoveEP<status.WhiteMove>(brd, from, enemy, to);
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "PawnEnpassantTake:\n"
 						<< _map(from | enemy, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, true);
@@ -341,6 +707,7 @@ public:
 	static float Pawnpush(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, false>(brd, from, to);
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Pawnpush:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -356,19 +723,23 @@ public:
 	static float Pawnpromote(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next1 = Board::MovePromote<BoardPiece::Queen, status.WhiteMove>(brd, from, to);
+		accumulatePlayed<depth>(brd, next1);
 		IFPRN std::cout << "Pawnpromote:\n"
 						<< _map(from, to, brd, next1) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next1, to & Enemy<status.WhiteMove>(brd));
 		float eval1 = PerfT<false, status.SilentMove(), depth - 1>(next1, alpha, beta);
 
 		Board next2 = Board::MovePromote<BoardPiece::Knight, status.WhiteMove>(brd, from, to);
+		accumulatePlayed<depth>(brd, next2);
 		KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		float eval2 = PerfT<false, status.SilentMove(), depth - 1>(next2, alpha, beta);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 
 		Board next3 = Board::MovePromote<BoardPiece::Bishop, status.WhiteMove>(brd, from, to);
+		accumulatePlayed<depth>(brd, next3);
 		float eval3 = PerfT<false, status.SilentMove(), depth - 1>(next3, alpha, beta);
 		Board next4 = Board::MovePromote<BoardPiece::Rook, status.WhiteMove>(brd, from, to);
+		accumulatePlayed<depth>(brd, next4);
 		float eval4 = PerfT<false, status.SilentMove(), depth - 1>(next4, alpha, beta);
 		if constexpr (status.WhiteMove)
 		{
@@ -384,6 +755,7 @@ public:
 	static float Knightmove(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Knight, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Knightmove:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -408,6 +780,7 @@ public:
 	static float Bishopmove(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Bishop, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Bishopmove:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -426,6 +799,7 @@ public:
 	static float Rookmove(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Rook, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Rookmove:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -465,6 +839,7 @@ public:
 	static float Queenmove(const Board &brd, uint64_t from, uint64_t to, float alpha, float beta)
 	{
 		Board next = Board::Move<BoardPiece::Queen, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		accumulatePlayed<depth>(brd, next);
 		IFPRN std::cout << "Queenmove:\n"
 						<< _map(from, to, brd, next) << "\n";
 		IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
@@ -481,9 +856,10 @@ public:
 };
 
 template <class BoardStatus status>
-static float PerfT(std::string_view def, Board &brd, int depth, float alpha, float beta, ChessNet &model, std::unordered_map<uint64_t, float> &evaluations_map)
+static float PerfT(std::string_view def, Board &brd, int depth, float alpha, float beta, ChessNet &model, EvalCache &evaluations_map)
 {
 	MoveReceiver::Init(brd, FEN::FenEnpassant(def), model, evaluations_map);
+	MoveReceiver::accumulateRoot(brd, depth);
 
 	switch (depth)
 	{
@@ -6,11 +6,15 @@
 
 namespace Movestack
 {
+    // All enumeration state is thread_local so independent searches can run on several threads (book builder)
     // Can be removed - incremental bitboard to save some slider lookups is more expensive then lookup itself. So this release does not have a changemap
-    static inline Square Atk_King[32];  // Current moves for current King
-    static inline Square Atk_EKing[32]; // Current enemy king attacked squares
+    static inline thread_local Square Atk_King[32];  // Current moves for current King
+    static inline thread_local Square Atk_EKing[32]; // Current enemy king attacked squares
 
-    static inline map Check_Status[32]; // When a pawn or a knight does check we can assume at least one check. And only one (initially) since a pawn or knight cannot do discovery
+    static inline thread_local map Check_Status[32]; // When a pawn or a knight does check we can assume at least one check. And only one (initially) since a pawn or knight cannot do discovery
+
+    static inline thread_local map Hash_Move[32]; // (from | to) of the transposition table move for this depth, searched first. 0 if none
+    static inline thread_local map Best_Move[32]; // (from | to) of the move that produced the best value at this depth, stored back into the transposition table
 }
 
 namespace Movelist
@@ -28,11 +32,11 @@ namespace Movelist
     };
 
     // move = atkmap + enemyorempty + checkmask + pins
-    map EnPassantTarget = {}; // Where the current EP Target is. Only valid if the movestatus contains EP flag.
+    thread_local map EnPassantTarget = {}; // Where the current EP Target is. Only valid if the movestatus contains EP flag.
 
     // These fields change during enumeration - so we have to copy them to a local variable!
-    map RookPin = {};   // Pins that run in rank or file direction - important because a queen can see two pins at once: https://lichess.org/editor?fen=3r4%2F8%2F8%2F3P4%2F3K1Q1r%2F8%2F8%2F8+w+-+-+0+1
-    map BishopPin = {}; // Pins that run in diagonal direction
+    thread_local map RookPin = {};   // Pins that run in rank or file direction - important because a queen can see two pins at once: https://lichess.org/editor?fen=3r4%2F8%2F8%2F3P4%2F3K1Q1r%2F8%2F8%2F8+w+-+-+0+1
+    thread_local map BishopPin = {}; // Pins that run in diagonal direction
 
     template <class BoardStatus status, int depth>
     _ForceInline void InitStack(Board &brd)
@@ -719,6 +723,12 @@ namespace Movelist
     template <class BoardStatus status, class Callback_Move, int depth>
     _NoInline float EnumerateMoves(Board &brd, float alpha, float beta) // This cannot be forceinline or even inline as its the main recursion entry point
     {
+        // Cooperative cancellation, the value is discarded by the caller
+        if (Callback_Move::Stopped())
+        {
+            return 0;
+        }
+
         // Elegant solution for checkmask. Just & with any valid move and it will always be correct.
         // 0 if double check - squares where we can stop a check otherwise. If no check is there - any square is ok (& with ullong max)
         map checkmask = Movestack::Check_Status[depth];
@@ -748,6 +758,8 @@ namespace Movelist
                     const Square sq = SquareOf(kingatk);
                     Movestack::Atk_EKing[depth - 1] = Lookup::King(sq);
                     float eval = Callback_Move::template Kingmove<status, depth>(brd, King<status.WhiteMove>(brd), 1ull << sq, alpha, beta);
+                    if (eval > value)
+                        Movestack::Best_Move[depth] = King<status.WhiteMove>(brd) | (1ull << sq);
                     value = std::max(value, eval);
                     alpha = std::max(alpha, value);
                     if (alpha >= beta and depth > treshold)
@@ -778,6 +790,8 @@ namespace Movelist
                     const Square sq = SquareOf(kingatk);
                     Movestack::Atk_EKing[depth - 1] = Lookup::King(sq);
                     float eval = Callback_Move::template Kingmove<status, depth>(brd, King<status.WhiteMove>(brd), 1ull << sq, alpha, beta);
+                    if (eval < value)
+                        Movestack::Best_Move[depth] = King<status.WhiteMove>(brd) | (1ull << sq);
                     value = std::min(value, eval);
                     beta = std::min(beta, value);
                     if (beta <= alpha and depth > treshold)
@@ -1136,6 +1150,19 @@ namespace Movelist
             }
         }
 
+        // The transposition table move from a previous search goes first
+        if (Movestack::Hash_Move[depth])
+        {
+            for (auto &move : moveList)
+            {
+                if ((move.from | move.to) == Movestack::Hash_Move[depth])
+                {
+                    move.score = 1000;
+                    break;
+                }
+            }
+        }
+
         // Order moves from best to worst
         std::sort(moveList.begin(), moveList.end(),
                   [](const MoveOrderingList &a, const MoveOrderingList &b)
@@ -1186,6 +1213,8 @@ namespace Movelist
                 std::cout << "ERROR " << i << " has an unrecognized moveType: " << static_cast<int>(move.moveType) << "\n";
                 break;
             }
+            if (eval > value)
+                Movestack::Best_Move[depth] = move.from | move.to;
             value = std::max(value, eval);
             alpha = std::max(alpha, value);
             if (alpha >= beta and depth > treshold)
@@ -1202,6 +1231,8 @@ namespace Movelist
                 const Square sq = SquareOf(kingatk);
                 Movestack::Atk_EKing[depth - 1] = Lookup::King(sq);
                 eval = Callback_Move::template Kingmove<status, depth>(brd, King<white>(brd), 1ull << sq, alpha, beta);
+                if (eval > value)
+                    Movestack::Best_Move[depth] = King<white>(brd) | (1ull << sq);
                 value = std::max(value, eval);
                 alpha = std::max(alpha, value);
                 if (alpha >= beta and depth > treshold)
@@ -1220,6 +1251,8 @@ namespace Movelist
 
                     Movestack::Atk_EKing[depth - 1] = Lookup::King(SquareOf(King<white>(brd) << 2));
                     eval = Callback_Move::template KingCastle<status, depth>(brd, (King<white>(brd) | King<white>(brd) << 2), status.Castle_RookswitchL(), alpha, beta);
+                    if (eval > value)
+                        Movestack::Best_Move[depth] = (King<white>(brd) | King<white>(brd) << 2) | status.Castle_RookswitchL();
                     value = std::max(value, eval);
                     alpha = std::max(alpha, value);
                     if (alpha >= beta and depth > treshold)
@@ -1235,6 +1268,8 @@ namespace Movelist
                 {
                     Movestack::Atk_EKing[depth - 1] = Lookup::King(SquareOf(King<white>(brd) >> 2));
                     eval = Callback_Move::template KingCastle<status, depth>(brd, (King<white>(brd) | King<white>(brd) >> 2), status.Castle_RookswitchR(), alpha, beta);
+                    if (eval > value)
+                        Movestack::Best_Move[depth] = (King<white>(brd) | King<white>(brd) >> 2) | status.Castle_RookswitchR();
                     value = std::max(value, eval);
                     alpha = std::max(alpha, value);
                     if (alpha >= beta and depth > treshold)
@@ -1526,6 +1561,19 @@ namespace Movelist
             }
         }
 
+        // The transposition table move from a previous search goes first
+        if (Movestack::Hash_Move[depth])
+        {
+            for (auto &move : moveList)
+            {
+                if ((move.from | move.to) == Movestack::Hash_Move[depth])
+                {
+                    move.score = 1000;
+                    break;
+                }
+            }
+        }
+
         // Order moves from best to worst
         std::sort(moveList.begin(), moveList.end(),
                   [](const MoveOrderingList &a, const MoveOrderingList &b)
@@ -1579,6 +1627,8 @@ namespace Movelist
                 std::cout << "ERROR " << i << " has an unrecognized moveType: " << static_cast<int>(move.moveType) << "\n";
                 break;
             }
+            if (eval < value)
+                Movestack::Best_Move[depth] = move.from | move.to;
             value = std::min(value, eval);
             beta = std::min(beta, value);
             if (beta <= alpha and depth > treshold)
@@ -1595,6 +1645,8 @@ namespace Movelist
                 const Square sq = SquareOf(kingatk);
                 Movestack::Atk_EKing[depth - 1] = Lookup::King(sq);
                 eval = Callback_Move::template Kingmove<status, depth>(brd, King<white>(brd), 1ull << sq, alpha, beta);
+                if (eval < value)
+                    Movestack::Best_Move[depth] = King<white>(brd) | (1ull << sq);
                 value = std::min(value, eval);
                 beta = std::min(beta, value);
                 if (beta <= alpha and depth > treshold)
@@ -1612,6 +1664,8 @@ namespace Movelist
                 {
                     Movestack::Atk_EKing[depth - 1] = Lookup::King(SquareOf(King<white>(brd) << 2));
                     eval = Callback_Move::template KingCastle<status, depth>(brd, (King<white>(brd) | King<white>(brd) << 2), status.Castle_RookswitchL(), alpha, beta);
+                    if (eval < value)
+                        Movestack::Best_Move[depth] = (King<white>(brd) | King<white>(brd) << 2) | status.Castle_RookswitchL();
                     value = std::min(value, eval);
                     beta = std::min(beta, value);
                     if (beta <= alpha and depth > treshold)
@@ -1627,6 +1681,8 @@ namespace Movelist
                 {
                     Movestack::Atk_EKing[depth - 1] = Lookup::King(SquareOf(King<white>(brd) >> 2));
                     eval = Callback_Move::template KingCastle<status, depth>(brd, (King<white>(brd) | King<white>(brd) >> 2), status.Castle_RookswitchR(), alpha, beta);
+                    if (eval < value)
+                        Movestack::Best_Move[depth] = (King<white>(brd) | King<white>(brd) >> 2) | status.Castle_RookswitchR();
                     value = std::min(value, eval);
                     beta = std::min(beta, value);
                     if (beta <= alpha and depth > treshold)
@@ -0,0 +1,66 @@
+#ifndef CDB_CACHE_H
+#define CDB_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Persistent cache of Chess Cloud Database answers.
+ *
+ * A memory mapped open addressing table of fixed size slots, keyed by a hash of the
+ * stripped FEN (board, turn, castling, en passant). Both moves and "nobestmove" answers
+ * are kept, each with its own time to live: the database keeps analysing, so an unknown
+ * position may have a move some days later. The file survives restarts, a position that
+ * was answered once does not go to the network again until its entry expires. Several
+ * engine processes may share the file: probes and stores hold a flock on it.
+ */
+class CloudDatabaseCache
+{
+public:
+    static constexpr std::int64_t MOVE_TTL_S = 30 * 24 * 3600;   // answers with a move
+    static constexpr std::int64_t NO_MOVE_TTL_S = 24 * 3600;     // "nobestmove" answers
+    static constexpr std::size_t DEFAULT_SLOTS = std::size_t(1) << 20; // 32 MB file
+
+    CloudDatabaseCache() = default;
+    ~CloudDatabaseCache();
+    CloudDatabaseCache(const CloudDatabaseCache &) = delete;
+    CloudDatabaseCache &operator=(const CloudDatabaseCache &) = delete;
+
+    // Maps the file, creating (or recreating, if the layout does not match) it with slots entries
+    bool open(const std::string &path, std::size_t slots = DEFAULT_SLOTS);
+    void close();
+    bool isOpen() const { return slots != nullptr; }
+
+    // true if an unexpired answer is cached, move is then a UCI move or "nobestmove"
+    bool probe(const std::string &fen, std::string &move);
+
+    void store(const std::string &fen, const std::string &move);
+
+private:
+    struct Slot
+    {
+        std::uint64_t key;     // 0 = empty
+        std::int64_t expires;  // unix time in seconds
+        char move[8];          // UCI move, empty for "nobestmove"
+        std::uint64_t reserved;
+    };
+
+    static std::uint64_t keyOf(const std::string &fen);
+
+    unsigned char *mapping = nullptr;
+    std::size_t mapped_bytes = 0;
+    Slot *slots = nullptr;
+    std::size_t mask = 0;
+    int lock_fd = -1; // the mapped file, kept open for flock
+    std::mutex mutex;
+};
+
+// Opens the process wide cache used by the cloud database lookups
+bool openCloudDatabaseCache(const std::string &path);
+
+// Process wide cache, answers are only cached while it is open
+CloudDatabaseCache &cloudDatabaseCache();
+
+#endif // CDB_CACHE_H
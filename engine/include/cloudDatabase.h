@@ -1,10 +1,61 @@
 #ifndef CLOUDDATABASE_H
 #define CLOUDDATABASE_H
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 
-// Declaration of the function implemented in cloudDatabase.cpp
-// Takes a FEN string as input, returns the best move.
+/**
+ * @brief Chess Cloud Database query running in the background while the local search runs.
+ *
+ * The server is http://www.chessdb.cn/cdb.php unless MASALOT_CDB_URL points somewhere else
+ * (for example a local stub server answering "move:e2e4,score:..." lines), every request is
+ * bounded by MASALOT_CDB_TIMEOUT_MS. The curl handles are kept between lookups, so the
+ * connection to the server is reused move after move. Only one lookup runs at a time.
+ * Answers are kept in the on-disk cache (cdb_cache.h) when it is open, a cached position
+ * is answered without a request.
+ */
+class CloudDatabaseLookup
+{
+public:
+    CloudDatabaseLookup();
+    ~CloudDatabaseLookup();
+    CloudDatabaseLookup(const CloudDatabaseLookup &) = delete;
+    CloudDatabaseLookup &operator=(const CloudDatabaseLookup &) = delete;
+
+    /**
+     * @brief Starts looking fen up, on_move is called from the lookup thread once a move has arrived.
+     * @return true if the answer came from the cache, finish() then returns it right away
+     *         (on_move is not called)
+     */
+    bool start(const std::string &fen, std::function<void()> on_move = nullptr);
+
+    // Waits for the answer, returns the move in UCI or "nobestmove"
+    std::string wait();
+
+    // Cancels the lookup if it is still running, returns the move if it already arrived or "nobestmove"
+    std::string finish();
+
+private:
+    void run();
+
+    void *easy = nullptr;  // CURL *
+    void *multi = nullptr; // CURLM *
+    std::string base_url;
+    std::string fen;
+    long timeout_ms;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::atomic<bool> cancelled{false};
+    std::function<void()> on_move;
+    std::string response;
+    std::string move = "nobestmove";
+};
+
+// Blocking lookup, takes a FEN string as input, returns the best move in UCI or "nobestmove"
 std::string getBestMoveFromCDB(const std::string& fen);
 
-#endif // CLOUDDATABASE_H
\ No newline at end of file
+#endif // CLOUDDATABASE_H
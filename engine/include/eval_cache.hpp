@@ -0,0 +1,282 @@
+#ifndef EVAL_CACHE_HPP
+#define EVAL_CACHE_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/**
+ * @brief Cache of network outputs shared by every search thread.
+ *
+ * Open addressing over a fixed power-of-two number of 8 byte entries, grouped in buckets of
+ * four (half a cache line). An entry packs the upper 27 bits of the key, the reachability
+ * signature of the position, the age of the search that wrote it and the evaluation as a
+ * half-precision float into one atomic word, so reads and writes never lock and a reader sees
+ * either the old or the new entry, never a mix. A store takes the slot of the same key, an
+ * empty one, or the one whose age is furthest behind.
+ *
+ * The signature (number of pieces, pawn steps left to promotion) never grows during a game, so
+ * after a capture or a pawn move every entry with a larger one can be dropped for good.
+ *
+ * The entries and the shared state are either owned or attached from a shared memory segment,
+ * in which case every process on the host reads and writes the same cache.
+ */
+class EvalCache {
+public:
+    // Counters that live next to the entries
+    struct State {
+        std::atomic<std::uint8_t> age{1};
+        std::atomic<std::size_t> used{0};
+    };
+
+    explicit EvalCache(std::size_t entries = (1ull << 22))
+    {
+        // Round down to a power of two, at least one bucket
+        std::size_t size = BUCKET;
+        while ((size << 1) <= entries)
+        {
+            size <<= 1;
+        }
+        owned = std::make_unique<std::atomic<std::uint64_t>[]>(size);
+        owned_state = std::make_unique<State>();
+        table = owned.get();
+        state = owned_state.get();
+        slots = size;
+        bucket_mask = size / BUCKET - 1;
+    }
+
+    /**
+     * @brief Uses entries and state owned by someone else (a shared memory segment) instead of
+     *        its own. entries must be a power of two of at least one bucket.
+     */
+    void attach(std::atomic<std::uint64_t> *shared, std::size_t entries, State *shared_state)
+    {
+        owned.reset();
+        owned_state.reset();
+        table = shared;
+        state = shared_state;
+        slots = entries;
+        bucket_mask = entries / BUCKET - 1;
+    }
+
+    bool shared() const { return !owned; }
+
+    EvalCache(const EvalCache &) = delete;
+    EvalCache &operator=(const EvalCache &) = delete;
+
+    /**
+     * @brief Looks up the key. Returns true and fills value on hit.
+     */
+    bool probe(std::uint64_t key, float &value)
+    {
+        std::atomic<std::uint64_t> *bucket = &table[(key & bucket_mask) * BUCKET];
+        const std::uint64_t tag = key & TAG_MASK;
+        for (std::size_t i = 0; i < BUCKET; i++)
+        {
+            std::uint64_t entry = bucket[i].load(std::memory_order_relaxed);
+            if (entry != 0 && (entry & TAG_MASK) == tag)
+            {
+                value = half_to_float(static_cast<std::uint16_t>(entry));
+                // Positions that keep being asked for should survive the next searches
+                const std::uint8_t current = state->age.load(std::memory_order_relaxed);
+                if (age_of(entry) != current)
+                {
+                    const std::uint64_t refreshed = (entry & ~AGE_MASK) | (static_cast<std::uint64_t>(current) << 16);
+                    bucket[i].compare_exchange_weak(entry, refreshed, std::memory_order_relaxed);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Reachability signature of a position: the number of pieces on the board and the
+     *        number of steps the pawns of both sides still have to promotion. Neither can grow,
+     *        captures and pawn moves make one of them smaller.
+     */
+    static std::uint16_t signature(std::uint64_t occupied, std::uint64_t white_pawns, std::uint64_t black_pawns)
+    {
+        int steps = 0;
+        for (int rank = 1; rank < 7; rank++)
+        {
+            const std::uint64_t mask = 0xFFull << (8 * rank);
+            steps += std::popcount(white_pawns & mask) * (7 - rank) + std::popcount(black_pawns & mask) * rank;
+        }
+        return static_cast<std::uint16_t>((std::popcount(occupied) << 7) | steps);
+    }
+
+    void store(std::uint64_t key, float value, std::uint16_t position_signature)
+    {
+        std::atomic<std::uint64_t> *bucket = &table[(key & bucket_mask) * BUCKET];
+        const std::uint64_t tag = key & TAG_MASK;
+        const std::uint8_t current = state->age.load(std::memory_order_relaxed);
+
+        std::size_t victim = 0;
+        int victim_distance = -1;
+        for (std::size_t i = 0; i < BUCKET; i++)
+        {
+            const std::uint64_t entry = bucket[i].load(std::memory_order_relaxed);
+            if (entry == 0 || (entry & TAG_MASK) == tag)
+            {
+                victim = i;
+                break;
+            }
+            const int distance = static_cast<std::uint8_t>(current - age_of(entry));
+            if (distance > victim_distance)
+            {
+                victim = i;
+                victim_distance = distance;
+            }
+        }
+
+        // A lost race with another thread only costs the entry it wrote
+        const std::uint64_t entry = pack(tag, position_signature, current, float_to_half(value));
+        const std::uint64_t previous = bucket[victim].exchange(entry, std::memory_order_relaxed);
+        if (previous == 0)
+        {
+            state->used.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Drops every entry the game at root (signature of the current position) can no
+     *        longer reach. Only scans the table when the root signature changed since last time.
+     * @return Number of dropped entries
+     */
+    std::size_t evict_unreachable(std::uint16_t root)
+    {
+        if (root == pruned_to)
+        {
+            return 0;
+        }
+        pruned_to = root;
+
+        std::size_t evicted = 0;
+        for (std::size_t i = 0; i < slots; i++)
+        {
+            std::atomic<std::uint64_t> &slot = table[i];
+            std::uint64_t entry = slot.load(std::memory_order_relaxed);
+            const std::uint16_t sig = signature_of(entry);
+            if (entry != 0 && ((sig >> 7) > (root >> 7) || (sig & 0x7F) > (root & 0x7F)) &&
+                slot.compare_exchange_strong(entry, 0, std::memory_order_relaxed))
+            {
+                evicted++;
+            }
+        }
+        state->used.fetch_sub(evicted, std::memory_order_relaxed);
+        return evicted;
+    }
+
+    // Call once at the start of every root search
+    void new_search()
+    {
+        std::uint8_t next = static_cast<std::uint8_t>(state->age.load(std::memory_order_relaxed) + 1);
+        state->age.store(next == 0 ? 1 : next, std::memory_order_relaxed);
+    }
+
+    // Not safe while a search is running, and not done on a shared cache (other processes use it)
+    void clear()
+    {
+        if (shared())
+        {
+            return;
+        }
+        for (std::size_t i = 0; i < slots; i++)
+        {
+            table[i].store(0, std::memory_order_relaxed);
+        }
+        state->used.store(0, std::memory_order_relaxed);
+        state->age.store(1, std::memory_order_relaxed);
+        pruned_to = 0;
+    }
+
+    // Number of filled entries
+    std::size_t size() const { return state->used.load(std::memory_order_relaxed); }
+    std::size_t capacity() const { return slots; }
+
+    // Packed entry i, for snapshots; safe while searches write
+    std::uint64_t raw(std::size_t i) const { return table[i].load(std::memory_order_relaxed); }
+
+    // Puts a packed entry of a snapshot of a cache with the same capacity back into slot i
+    void restore(std::size_t i, std::uint64_t entry)
+    {
+        if (entry != 0 && table[i].exchange(entry, std::memory_order_relaxed) == 0)
+        {
+            state->used.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static constexpr std::size_t BUCKET = 4;
+    // Upper 27 bits of the key; the lower bits pick the bucket
+    static constexpr std::uint64_t TAG_MASK = ~0ull << 37;
+    static constexpr std::uint64_t AGE_MASK = 0xFFull << 16;
+
+    // tag | signature << 24 | age << 16 | half precision eval; age is never 0 so a filled entry is never 0
+    static std::uint64_t pack(std::uint64_t tag, std::uint16_t position_signature, std::uint8_t entry_age, std::uint16_t half)
+    {
+        return tag | (static_cast<std::uint64_t>(position_signature & 0x1FFF) << 24) |
+               (static_cast<std::uint64_t>(entry_age) << 16) | half;
+    }
+
+    static std::uint8_t age_of(std::uint64_t entry) { return static_cast<std::uint8_t>(entry >> 16); }
+    static std::uint16_t signature_of(std::uint64_t entry) { return static_cast<std::uint16_t>((entry >> 24) & 0x1FFF); }
+
+    // IEEE half precision with round to nearest; the evaluations stay far inside its normal range
+    static std::uint16_t float_to_half(float value)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const std::uint32_t sign = (bits >> 16) & 0x8000u;
+        const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+        std::uint32_t mantissa = bits & 0x7FFFFFu;
+
+        if (exponent <= 0)
+        {
+            return static_cast<std::uint16_t>(sign); // too small, flush to zero
+        }
+        if (exponent >= 31)
+        {
+            return static_cast<std::uint16_t>(sign | 0x7C00u); // too large, infinity
+        }
+        std::uint32_t half = sign | (static_cast<std::uint32_t>(exponent) << 10) | (mantissa >> 13);
+        if ((mantissa & 0x1FFFu) > 0x1000u || ((mantissa & 0x1FFFu) == 0x1000u && (half & 1u)))
+        {
+            half++; // a carry into the exponent is still the correctly rounded value
+        }
+        return static_cast<std::uint16_t>(half);
+    }
+
+    static float half_to_float(std::uint16_t half)
+    {
+        const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000u) << 16;
+        const std::uint32_t exponent = (half >> 10) & 0x1F;
+        const std::uint32_t mantissa = half & 0x3FFu;
+
+        std::uint32_t bits = sign;
+        if (exponent == 31)
+        {
+            bits |= 0x7F800000u | (mantissa << 13);
+        }
+        else if (exponent != 0)
+        {
+            bits |= ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> owned;
+    std::unique_ptr<State> owned_state;
+    std::atomic<std::uint64_t> *table = nullptr;
+    State *state = nullptr;
+    std::size_t slots = 0;
+    std::size_t bucket_mask = 0;
+    std::uint16_t pruned_to = 0; // root signature of the last eviction, 0 before the first
+};
+
+#endif // EVAL_CACHE_HPP
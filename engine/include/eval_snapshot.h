@@ -0,0 +1,50 @@
+#ifndef EVAL_SNAPSHOT_H
+#define EVAL_SNAPSHOT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "eval_cache.hpp"
+
+/**
+ * @brief Snapshots of the evaluation cache on disk, so a restarted server does not start cold.
+ *
+ * The file holds the packed entries of the cache behind a header with the capacity and a
+ * fingerprint of the network weights and leaf backend (evalCacheFingerprint); a snapshot of
+ * another network, backend or cache size is ignored. Loading maps the file and copies the entries in. Saving runs on a background thread
+ * that reads the cache while searches keep writing to it, into a temporary file that is then
+ * renamed over the old snapshot, so a crash never leaves a half written one behind.
+ */
+class EvalCacheSnapshots
+{
+public:
+    static constexpr int DEFAULT_INTERVAL_S = 300;
+
+    EvalCacheSnapshots(EvalCache &cache, const std::string &path, std::uint64_t fingerprint,
+                       int interval_s = DEFAULT_INTERVAL_S);
+    // Waits for a running snapshot and writes a last one
+    ~EvalCacheSnapshots();
+    EvalCacheSnapshots(const EvalCacheSnapshots &) = delete;
+    EvalCacheSnapshots &operator=(const EvalCacheSnapshots &) = delete;
+
+    // Fills an empty cache from the snapshot, returns the number of entries loaded
+    std::size_t load();
+
+    // Starts a snapshot in the background if the last one is older than the interval and done
+    void saveInBackground();
+
+private:
+    bool save();
+
+    EvalCache &cache;
+    std::string path;
+    std::uint64_t fingerprint;
+    std::chrono::seconds interval;
+    std::chrono::steady_clock::time_point last_save;
+    std::thread worker;
+    std::atomic<bool> saving{false};
+};
+
+#endif // EVAL_SNAPSHOT_H
@@ -8,6 +8,10 @@
 #include <unordered_map>
 #include "../../training/include/chessnet.h"
 #include "../include/data_preparation.h"
+#include "../include/transposition.hpp"
+#include "../include/eval_cache.hpp"
+#include "../include/search_control.hpp"
+#include "../include/cloudDatabase.h"
 
 
 std::vector<std::string> generate_positions(std::string pos, bool isWhite);
@@ -26,7 +30,34 @@ struct bestMoveInfo
     float eval;
 };
 
-// std::string search_best_move(ChessNet &model, std::string &pos, int depth, std::unordered_map<uint64_t, float> &evaluations_map, const std::unordered_set<std::string> &previous_positions);
+/**
+ * @brief Search state kept between consecutive moves of one game.
+ *
+ * When the next position sent by the client is one or two plies below the
+ * previous root, the transposition table (values, hash moves) and the
+ * principal variation are reused to seed iterative deepening. Otherwise
+ * the session is cleared.
+ */
+struct SearchSession
+{
+    TranspositionTable transposition_table;
+    std::string root;            // FEN of the last searched position
+    std::vector<std::string> pv; // FENs: root, chosen move, expected reply
+    SearchControl control;       // stop / ponder flags of the search currently using the session
+    bool use_book = true;        // consult the opening book before searching
+    bool use_cloud_database = true;
+    bool prune_eval_cache = true; // drop evaluations the game can no longer reach; off when unrelated searches share the cache
+    CloudDatabaseLookup cloud_lookup; // Chess Cloud Database query racing the local search
+
+    void clear()
+    {
+        transposition_table.clear();
+        root.clear();
+        pv.clear();
+    }
+};
+
+// std::string search_best_move(ChessNet &model, std::string &pos, int depth, EvalCache &evaluations_map, const std::unordered_set<std::string> &previous_positions);
 
 bool isSafeMove(const std::string &candidate_pos, 
     const std::unordered_set<std::string> &previous_positions);
@@ -35,12 +66,54 @@ bestMoveInfo search_best_move(
     ChessNet &model,
     const std::string &pos,
     int depth,
-    std::unordered_map<uint64_t, float> &evaluations_map,
-    std::unordered_set<std::string> &previous_positions // note: pass by reference
+    EvalCache &evaluations_map,
+    std::unordered_set<std::string> &previous_positions, // note: pass by reference
+    SearchSession &session
 );
 
 std::string stripFen(const std::string &fen);
 
+std::string positionKey(const std::string &fen);
+
+// Hash of the network weights (parameters and buffers), evaluations of other weights are not reused
+uint64_t modelFingerprint(ChessNet &model);
+
+// Hash of the weights and of the forward pass enabled for the leaves (int8 file, CPU, frozen model,
+// NNUE or libtorch on its device), whose outputs differ within its tolerance. Call after the
+// enable functions: cache entries, snapshots and shared tables of another backend are not reused.
+uint64_t evalCacheFingerprint(ChessNet &model);
+
+/**
+ * @brief Switches the search to the libtorch free forward pass (ConvInference) of the model.
+ *        Exports the folded weights to path when the file there is missing or of other weights,
+ *        and only enables it when it agrees with the model on a few test positions. The search
+ *        keeps conv1 as an accumulator updated move by move and evaluates leaves from conv2 on.
+ *        Process wide, a later call keeps the network already enabled.
+ */
+bool enableCpuInference(ChessNet &model, const std::string &path);
+
+/**
+ * @brief Switches the search to the int8 forward pass (Int8Inference) of the model, if path
+ *        holds a quantization of these weights and it agrees roughly with the model.
+ *        Process wide, takes precedence over enableCpuInference.
+ */
+bool enableInt8Inference(ChessNet &model, const std::string &path);
+
+/**
+ * @brief Runs the libtorch leaves on a frozen TorchScript copy of the model (BatchNorms folded,
+ *        under InferenceMode). Writes it to path when the file there is missing or of other
+ *        weights, checks it against the model and prints the latency of both at batch 1 and 64.
+ *        Process wide, only used when no hand written forward pass is enabled.
+ */
+bool enableFrozenModel(ChessNet &model, const std::string &path);
+
+/**
+ * @brief Switches the search to the NNUE network at path (NNUEInference), written by training
+ *        for NNUEHalfKP. Its accumulators follow the moves of the search, so it evaluates leaves
+ *        without the model or the evaluation cache. Process wide, takes precedence over the others.
+ */
+bool enableNnueInference(const std::string &path);
+
 int countBoardPoints(const std::string& fen);
 
 #endif  // EVALUATE_H
\ No newline at end of file
@@ -0,0 +1,209 @@
+#ifndef KPK_BITBASE_HPP
+#define KPK_BITBASE_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief King and pawn against king, win or draw.
+ *
+ * One bit per position (side to move, both kings, pawn on files a-d and ranks 2-7, the other
+ * files are mirrored): 2 * 64 * 64 * 24 bits = 24 KB. The table is solved by retrograde
+ * classification once, at the first probe (a few milliseconds; solving it in a constexpr
+ * initializer cost every translation unit including this header over a minute of compile
+ * time), then probing is an index computation and a bit test. Squares are numbered
+ * a1 = 0 .. h8 = 63, white has the pawn.
+ */
+namespace KPK
+{
+    constexpr int MAX_INDEX = 2 * 24 * 64 * 64;
+
+    enum Result : uint8_t
+    {
+        INVALID = 0,
+        UNKNOWN = 1,
+        DRAW = 2,
+        WIN = 4
+    };
+
+    constexpr int file_of(int sq) { return sq & 7; }
+    constexpr int rank_of(int sq) { return sq >> 3; }
+
+    constexpr int distance(int a, int b)
+    {
+        int files = file_of(a) > file_of(b) ? file_of(a) - file_of(b) : file_of(b) - file_of(a);
+        int ranks = rank_of(a) > rank_of(b) ? rank_of(a) - rank_of(b) : rank_of(b) - rank_of(a);
+        return files > ranks ? files : ranks;
+    }
+
+    constexpr int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+    // Square next to sq in direction step, -1 off the board
+    constexpr int king_step(int sq, int step)
+    {
+        const int file = file_of(sq) + KING_STEPS[step][0];
+        const int rank = rank_of(sq) + KING_STEPS[step][1];
+        return (file < 0 || file > 7 || rank < 0 || rank > 7) ? -1 : 8 * rank + file;
+    }
+
+    // White pawn on psq attacks sq
+    constexpr bool pawn_attacks(int psq, int sq)
+    {
+        return rank_of(sq) == rank_of(psq) + 1 && (file_of(sq) == file_of(psq) - 1 || file_of(sq) == file_of(psq) + 1);
+    }
+
+    // Stm in bit 12, pawn file (a-d) in bits 13-14, 7th rank minus pawn rank in bits 15-17
+    constexpr int index(bool white_to_move, int bksq, int wksq, int psq)
+    {
+        return wksq | (bksq << 6) | ((white_to_move ? 0 : 1) << 12) | (file_of(psq) << 13) | ((6 - rank_of(psq)) << 15);
+    }
+
+    constexpr uint8_t initial(int idx)
+    {
+        const int wksq = idx & 0x3F;
+        const int bksq = (idx >> 6) & 0x3F;
+        const bool white = ((idx >> 12) & 1) == 0;
+        const int psq = 8 * (6 - ((idx >> 15) & 7)) + ((idx >> 13) & 3);
+
+        if (distance(wksq, bksq) <= 1 || wksq == psq || bksq == psq || (white && pawn_attacks(psq, bksq)))
+        {
+            return INVALID;
+        }
+
+        // Immediate promotion the black king cannot stop
+        if (white && rank_of(psq) == 6 && wksq != psq + 8 &&
+            (distance(bksq, psq + 8) > 1 || distance(wksq, psq + 8) == 1))
+        {
+            return WIN;
+        }
+
+        if (!white)
+        {
+            // Stalemate, or the black king takes the undefended pawn
+            bool can_move = false;
+            for (int step = 0; step < 8; step++)
+            {
+                const int sq = king_step(bksq, step);
+                if (sq < 0)
+                {
+                    continue;
+                }
+                if (sq == psq && distance(wksq, psq) > 1)
+                {
+                    return DRAW;
+                }
+                if (distance(wksq, sq) > 1 && !pawn_attacks(psq, sq))
+                {
+                    can_move = true;
+                }
+            }
+            if (!can_move)
+            {
+                return DRAW;
+            }
+        }
+        return UNKNOWN;
+    }
+
+    // White wins if one move wins, black draws if one move draws
+    inline uint8_t classify(const std::vector<uint8_t> &db, int idx)
+    {
+        const int wksq = idx & 0x3F;
+        const int bksq = (idx >> 6) & 0x3F;
+        const bool white = ((idx >> 12) & 1) == 0;
+        const int psq = 8 * (6 - ((idx >> 15) & 7)) + ((idx >> 13) & 3);
+
+        const uint8_t good = white ? WIN : DRAW;
+        const uint8_t bad = white ? DRAW : WIN;
+
+        uint8_t r = INVALID;
+        const int ksq = white ? wksq : bksq;
+        for (int step = 0; step < 8; step++)
+        {
+            const int sq = king_step(ksq, step);
+            if (sq >= 0)
+            {
+                r |= white ? db[index(false, bksq, sq, psq)] : db[index(true, sq, wksq, psq)];
+            }
+        }
+
+        if (white)
+        {
+            if (rank_of(psq) < 6)
+            {
+                r |= db[index(false, bksq, wksq, psq + 8)];
+            }
+            if (rank_of(psq) == 1 && psq + 8 != wksq && psq + 8 != bksq)
+            {
+                r |= db[index(false, bksq, wksq, psq + 16)];
+            }
+        }
+
+        return (r & good) ? good : (r & UNKNOWN) ? static_cast<uint8_t>(UNKNOWN) : bad;
+    }
+
+    inline std::array<uint32_t, MAX_INDEX / 32> generate()
+    {
+        std::vector<uint8_t> db(MAX_INDEX);
+        for (int idx = 0; idx < MAX_INDEX; idx++)
+        {
+            db[idx] = initial(idx);
+        }
+
+        // Pawn moves only lead to slices solved before (higher pawn rank first), so each
+        // slice is iterated on its own and the solved ones are not visited again
+        for (int slice = 0; slice < 6; slice++)
+        {
+            bool changed = true;
+            while (changed)
+            {
+                changed = false;
+                for (int idx = slice << 15; idx < (slice + 1) << 15; idx++)
+                {
+                    if (db[idx] == UNKNOWN)
+                    {
+                        db[idx] = classify(db, idx);
+                        changed |= db[idx] != UNKNOWN;
+                    }
+                }
+            }
+        }
+
+        std::array<uint32_t, MAX_INDEX / 32> bits{};
+        for (int idx = 0; idx < MAX_INDEX; idx++)
+        {
+            if (db[idx] == WIN)
+            {
+                bits[idx / 32] |= 1u << (idx % 32);
+            }
+        }
+        return bits;
+    }
+
+    // Solved on first use, thread safe (search threads may probe at the same time)
+    inline const std::array<uint32_t, MAX_INDEX / 32> &bitbase()
+    {
+        static const std::array<uint32_t, MAX_INDEX / 32> bits = generate();
+        return bits;
+    }
+
+    /**
+     * @brief true if the side with the pawn wins.
+     * @param strong_to_move the side with the pawn is to move
+     * Squares from the side of the pawn: mirror the ranks first if black has the pawn.
+     */
+    inline bool probe(bool strong_to_move, int strong_king, int pawn, int weak_king)
+    {
+        if (file_of(pawn) > 3)
+        {
+            strong_king ^= 7;
+            pawn ^= 7;
+            weak_king ^= 7;
+        }
+        const int idx = index(strong_to_move, weak_king, strong_king, pawn);
+        return (bitbase()[idx / 32] >> (idx % 32)) & 1;
+    }
+}
+
+#endif // KPK_BITBASE_HPP
@@ -0,0 +1,64 @@
+#ifndef POLYGLOT_BOOK_H
+#define POLYGLOT_BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One 16 byte record of a Polyglot .bin book, stored big-endian on disk
+struct PolyglotEntry
+{
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+/**
+ * @brief Read-only Polyglot opening book.
+ *
+ * The file is memory mapped, entries are sorted by key so a lookup is a
+ * binary search over the mapping. Keys are the standard Polyglot Zobrist
+ * keys, compiled in (see polyglot_keys.hpp).
+ */
+class PolyglotBook
+{
+public:
+    PolyglotBook() = default;
+    ~PolyglotBook();
+    PolyglotBook(const PolyglotBook &) = delete;
+    PolyglotBook &operator=(const PolyglotBook &) = delete;
+
+    bool open(const std::string &book_path);
+    void close();
+    bool isOpen() const { return entries != nullptr; }
+    std::size_t size() const { return count; }
+
+    // All book moves of the position, in file order
+    std::vector<PolyglotEntry> probe(uint64_t key) const;
+
+    // Weighted random choice among the book moves, UCI notation. "nobestmove" if not in the book.
+    std::string pickMove(const std::string &fen) const;
+
+    static std::string moveToUci(uint16_t move, const std::string &fen);
+
+private:
+    const unsigned char *entries = nullptr;
+    std::size_t count = 0;
+    std::size_t mapped_bytes = 0;
+};
+
+// Polyglot Zobrist key of a position given as FEN
+uint64_t polyglotKey(const std::string &fen);
+
+// Polyglot move encoding of a UCI move (castling as king takes rook, as the format wants)
+uint16_t polyglotMove(const std::string &uci, const std::string &fen);
+
+// Opens the process wide book used by search_best_move
+bool openBook(const std::string &book_path);
+
+// Takes a FEN string as input, returns a book move in UCI or "nobestmove"
+std::string getBestMoveFromBook(const std::string &fen);
+
+#endif // POLYGLOT_BOOK_H
@@ -0,0 +1,65 @@
+#ifndef SEARCH_CONTROL_HPP
+#define SEARCH_CONTROL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Cancellation token shared between a running search and the connection thread.
+ *
+ * The connection thread sets stop (client sent "stop", disconnected or the ponder move
+ * was not played) or a deadline; the search polls it and unwinds. A stopped search does
+ * not store anything into the transposition table and the root throws the unfinished
+ * iteration away, answering with the last finished one.
+ */
+struct SearchControl
+{
+    std::atomic<bool> stop{false};         // abort the running search as soon as possible
+    std::atomic<bool> pondering{false};    // searching the expected reply on the opponent's time, no deadline
+    std::atomic<std::int64_t> deadline{0}; // steady_clock time in ns when the search has to stop, 0 = none
+
+    bool stopped() const { return stop.load(std::memory_order_relaxed); }
+
+    // ms <= 0 removes the deadline
+    void set_deadline_ms(int ms)
+    {
+        if (ms <= 0)
+        {
+            deadline = 0;
+            return;
+        }
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Sets stop once the deadline has passed. While pondering the clock does not run yet,
+     *        it starts on a ponder hit.
+     * @return true if the search has to stop
+     */
+    bool check_deadline()
+    {
+        std::int64_t end = deadline.load(std::memory_order_relaxed);
+        if (end != 0 && !pondering.load(std::memory_order_relaxed))
+        {
+            std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count();
+            if (now >= end)
+            {
+                stop.store(true, std::memory_order_relaxed);
+            }
+        }
+        return stopped();
+    }
+
+    void reset()
+    {
+        stop = false;
+        pondering = false;
+        deadline = 0;
+    }
+};
+
+#endif // SEARCH_CONTROL_HPP
@@ -0,0 +1,54 @@
+#ifndef SHARED_TABLES_H
+#define SHARED_TABLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "eval_cache.hpp"
+#include "transposition.hpp"
+
+/**
+ * @brief Evaluation cache and transposition table in a POSIX shared memory segment.
+ *
+ * Several engine processes on one host attach to the same segment (shm_open + mmap), so a
+ * position evaluated by the network in one of them is a cache hit in all the others. The
+ * first process creates and sizes the segment, the others take its layout from the header.
+ * Both tables are lock free (atomic 64 bit words), nothing in the segment is ever locked.
+ * The first process to attach claims the segment for its evaluation cache fingerprint
+ * (weights and leaf backend), processes with another one are refused.
+ */
+class SharedTables
+{
+public:
+    SharedTables() = default;
+    ~SharedTables();
+    SharedTables(const SharedTables &) = delete;
+    SharedTables &operator=(const SharedTables &) = delete;
+
+    /**
+     * @brief Creates the segment with about megabytes of tables (half each), or attaches to
+     *        the existing one of that name, whatever its size.
+     */
+    bool open(const std::string &name, std::size_t megabytes);
+    void close();
+    bool isOpen() const { return mapping != nullptr; }
+
+    // Points the cache and the table at the segment, which must stay open while they are used.
+    // False if the segment belongs to another fingerprint (see evalCacheFingerprint).
+    bool attach(EvalCache &cache, TranspositionTable &table, std::uint64_t fingerprint);
+
+private:
+    struct Header;
+
+    unsigned char *mapping = nullptr;
+    std::size_t mapped_bytes = 0;
+    Header *header = nullptr;
+};
+
+// Opens the process wide segment
+bool openSharedTables(const std::string &name, std::size_t megabytes);
+
+// Attaches a cache and a table to the process wide segment, false if it is not open or of another fingerprint
+bool attachSharedTables(EvalCache &cache, TranspositionTable &table, std::uint64_t fingerprint);
+
+#endif // SHARED_TABLES_H
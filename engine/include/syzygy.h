@@ -0,0 +1,37 @@
+#ifndef SYZYGY_H
+#define SYZYGY_H
+
+#include <cstdint>
+#include <string>
+
+// Syzygy tablebases through Fathom. Without USE_SYZYGY (see CMakeLists.txt) nothing is
+// found and every probe fails, so callers do not need to check how the engine was built.
+
+// Loads the tables of a directory (several separated by ':'), the tables are memory mapped
+bool openSyzygy(const std::string &paths);
+
+// Positions with at most this many pieces are probed, 0 when no tables are loaded
+int syzygyProbeLimit();
+
+// Lowers the probe limit below the largest tables found (e.g. to keep 7 man probes out of the search)
+void setSyzygyProbeLimit(int pieces);
+
+/**
+ * @brief WDL probe for the search, Gigantua bitboards (bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk).
+ *        Only for positions without castling rights and en passant square, the fifty move counter
+ *        is taken as 0.
+ * @param wdl 1 win, 0 draw (also cursed wins and blessed losses), -1 loss for the side to move
+ */
+bool probeSyzygyWdl(const uint64_t pieces[12], bool white_to_move, int &wdl);
+
+/**
+ * @brief DTZ probe at the root: the move keeping the result and, when winning, the shortest
+ *        way to the next zeroing move. Fathom's root probe is not thread safe, calls are serialized.
+ * @return the move in UCI, "nobestmove" if the position is not in the tables
+ */
+std::string probeSyzygyRoot(const std::string &fen, int &wdl);
+
+// Successful probes since the start, root and search
+uint64_t syzygyHits();
+
+#endif // SYZYGY_H
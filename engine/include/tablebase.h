@@ -0,0 +1,129 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Largest endings the generator builds and the search probes (kings included)
+constexpr int TB_MAX_PIECES = 4;
+
+// Piece codes, colour in bit 3
+enum TBPiece : uint8_t
+{
+    TB_PAWN = 1,
+    TB_KNIGHT = 2,
+    TB_BISHOP = 3,
+    TB_ROOK = 4,
+    TB_QUEEN = 5,
+    TB_KING = 6
+};
+constexpr uint8_t TB_BLACK = 8;
+
+// One byte per position, from the side to move:
+//   0        draw (also illegal positions)
+//   1..127   side to move mates in n moves
+//   128 + n  side to move is mated in n moves (128 = checkmated)
+//   255      not known yet, only while generating
+constexpr uint8_t TB_DRAW = 0;
+constexpr uint8_t TB_LOSS = 128;
+constexpr uint8_t TB_UNKNOWN = 255;
+
+/**
+ * @brief Position of at most TB_MAX_PIECES pieces, squares numbered a1 = 0 .. h8 = 63.
+ *        En passant and castling rights are not part of the tables.
+ */
+struct TBPosition
+{
+    int count = 0;
+    uint8_t piece[TB_MAX_PIECES];
+    uint8_t square[TB_MAX_PIECES];
+    bool white_to_move = true;
+
+    void add(uint8_t p, int sq)
+    {
+        piece[count] = p;
+        square[count] = static_cast<uint8_t>(sq);
+        count++;
+    }
+};
+
+struct TBResult
+{
+    int wdl;   // side to move: 1 win, 0 draw, -1 loss
+    int moves; // moves until mate, 0 for draws
+};
+
+/**
+ * @brief Sorts the pieces into table order (white king, white pieces by value, black king,
+ *        black pieces) and swaps the colours if black is the stronger side, so each ending
+ *        has one table with the stronger side as white.
+ * @return Material key of the table: the piece codes in table order, one per byte
+ */
+uint32_t normalizePosition(TBPosition &pos);
+
+// "KQvKR" for the key of king and queen against king and rook, and back
+std::string tableName(uint32_t material);
+uint32_t tableMaterial(const std::string &name);
+
+// Number of positions (bytes) of a table
+uint64_t tableEntries(uint32_t material);
+
+// Index of a normalized position in its table, with the board symmetries folded away
+uint64_t positionIndex(uint32_t material, const TBPosition &pos);
+
+// Position of an index (one of the symmetric ones), used by the generator
+void decodeIndex(uint32_t material, uint64_t index, TBPosition &pos);
+
+// Every 3 and 4 man table, in an order where captures and promotions only lead into earlier tables
+std::vector<uint32_t> allTables();
+
+/**
+ * @brief Set of loaded tables.
+ *
+ * Table files (<name>.mtb: 8 byte magic, 8 byte entry count, one byte per position) are
+ * memory mapped, the generator attaches the tables it has built in memory.
+ */
+class Tablebases
+{
+public:
+    Tablebases() = default;
+    ~Tablebases();
+    Tablebases(const Tablebases &) = delete;
+    Tablebases &operator=(const Tablebases &) = delete;
+
+    // Maps every table found in directory, returns the number of tables
+    std::size_t load(const std::string &directory);
+    void attach(uint32_t material, const uint8_t *data);
+    std::size_t size() const { return tables.size(); }
+
+    // Value byte of a position (any colour, any order of pieces), TB_UNKNOWN if its table is missing
+    uint8_t value(TBPosition pos) const;
+
+private:
+    struct Table
+    {
+        const uint8_t *data = nullptr;
+        void *mapping = nullptr;
+        std::size_t mapped_bytes = 0;
+    };
+    std::unordered_map<uint32_t, Table> tables;
+};
+
+bool writeTable(const std::string &path, const std::vector<uint8_t> &values);
+
+// Opens the process wide tables used by the search
+bool openTablebases(const std::string &directory);
+
+bool tablebasesLoaded();
+
+/**
+ * @brief Probes the process wide tables with the Gigantua bitboards
+ *        (order bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk; bit = rank * 8 + (7 - file)).
+ * @return false if there are too many pieces or the table is not loaded
+ */
+bool probeTablebase(const uint64_t pieces[12], bool white_to_move, TBResult &result);
+
+#endif // TABLEBASE_H
@@ -0,0 +1,173 @@
+#ifndef TRANSPOSITION_HPP
+#define TRANSPOSITION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Kind of score stored in a transposition table entry (fail-soft alpha-beta)
+enum TTBound : std::uint8_t {
+    TT_NONE = 0,  // empty slot
+    TT_EXACT,     // alpha < value < beta
+    TT_LOWER,     // value >= beta  (cutoff, real score may be higher)
+    TT_UPPER      // value <= alpha (no move raised alpha, real score may be lower)
+};
+
+/**
+ * @brief One slot of the transposition table.
+ *
+ * best_move is stored as (from | to) bitboard of the moving side, the same
+ * mask that the move generator uses, so it can be matched against the
+ * generated move list without any extra encoding. For castling it is
+ * kingswitch | rookswitch.
+ */
+struct TTEntry {
+    std::uint64_t key = 0;
+    float value = 0.0f;
+    std::uint64_t best_move = 0;
+    std::int8_t depth = -1;
+    TTBound bound = TT_NONE;
+    std::uint8_t generation = 0;
+};
+static_assert(sizeof(TTEntry) == 32, "TTEntry is stored as four 64 bit words");
+
+/**
+ * @brief Storage of one entry: the four words of a TTEntry, the first one XORed with the other
+ *        three. Writers and readers never lock; a reader that catches a half written slot (another
+ *        thread or process sharing the table) sees a key that does not match and treats it as a miss.
+ */
+struct TTSlot {
+    std::atomic<std::uint64_t> word[4];
+};
+static_assert(sizeof(TTSlot) == sizeof(TTEntry), "TTSlot must have the layout of TTEntry");
+
+/**
+ * @brief Fixed size, always-replace-if-stale transposition table.
+ *
+ * The table survives between consecutive moves of one game. Every search
+ * bumps the generation so entries of older searches are preferred victims,
+ * but until they are overwritten they still provide hash moves and cutoffs.
+ * The slots are either owned or attached from a shared memory segment.
+ */
+class TranspositionTable {
+public:
+    explicit TranspositionTable(std::size_t entries = (1ull << 20))
+    {
+        // Round down to a power of two so the index is a simple mask
+        std::size_t size = 1;
+        while ((size << 1) <= entries)
+        {
+            size <<= 1;
+        }
+        owned = std::make_unique<TTSlot[]>(size);
+        table = owned.get();
+        slots = size;
+        mask = size - 1;
+    }
+
+    /**
+     * @brief Uses slots owned by someone else (a shared memory segment) instead of its own.
+     *        entries must be a power of two.
+     */
+    void attach(TTSlot *shared, std::size_t entries)
+    {
+        owned.reset();
+        table = shared;
+        slots = entries;
+        mask = entries - 1;
+    }
+
+    /**
+     * @brief Looks up the key. Returns true and fills entry on hit.
+     */
+    bool probe(std::uint64_t key, TTEntry &entry) const
+    {
+        const TTEntry slot = load(table[key & mask]);
+        if (slot.bound == TT_NONE || slot.key != key)
+        {
+            return false;
+        }
+        entry = slot;
+        return true;
+    }
+
+    /**
+     * @brief Stores a search result. Entries from older searches are always
+     *        replaced, entries of the current search only by equal or deeper results.
+     */
+    void store(std::uint64_t key, float value, std::uint64_t best_move, int depth, TTBound bound)
+    {
+        TTEntry slot = load(table[key & mask]);
+        if (slot.bound != TT_NONE && slot.generation == generation && slot.key != key && depth < slot.depth)
+        {
+            return;
+        }
+        // Keep the old hash move when the new result does not have one (e.g. fail low)
+        if (best_move == 0 && slot.key == key)
+        {
+            best_move = slot.best_move;
+        }
+        slot.key = key;
+        slot.value = value;
+        slot.best_move = best_move;
+        slot.depth = static_cast<std::int8_t>(depth);
+        slot.bound = bound;
+        slot.generation = generation;
+        save(table[key & mask], slot);
+    }
+
+    // Call once at the start of every root search
+    void new_search() { generation++; }
+
+    void clear()
+    {
+        if (!owned)
+        {
+            // Other processes still use a shared table: only make the old entries stale
+            generation++;
+            return;
+        }
+        for (std::size_t i = 0; i < slots; i++)
+        {
+            save(table[i], TTEntry{});
+        }
+        generation = 0;
+    }
+
+    std::size_t size() const { return slots; }
+
+private:
+    static TTEntry load(const TTSlot &slot)
+    {
+        std::uint64_t words[4];
+        for (int i = 0; i < 4; i++)
+        {
+            words[i] = slot.word[i].load(std::memory_order_relaxed);
+        }
+        words[0] ^= words[1] ^ words[2] ^ words[3];
+        TTEntry entry;
+        std::memcpy(&entry, words, sizeof(entry));
+        return entry;
+    }
+
+    static void save(TTSlot &slot, const TTEntry &entry)
+    {
+        std::uint64_t words[4];
+        std::memcpy(words, &entry, sizeof(entry));
+        words[0] ^= words[1] ^ words[2] ^ words[3];
+        for (int i = 0; i < 4; i++)
+        {
+            slot.word[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::unique_ptr<TTSlot[]> owned;
+    TTSlot *table = nullptr;
+    std::size_t slots = 0;
+    std::size_t mask = 0;
+    std::uint8_t generation = 0;
+};
+
+#endif // TRANSPOSITION_HPP
@@ -3,7 +3,9 @@
 
 #include <cstdint>
 #include <random>
+#include <type_traits>
 #include "../giga/Chess_Base.hpp"
+#include "../../training/include/chessnet.h"
 
 // Define piece indices for Zobrist hashing
 enum {
@@ -112,4 +114,57 @@ inline std::uint64_t computeZobristHash(const Board &b, const BoardStatus &st, c
     return hash;
 }
 
+/**
+ * @brief Hash of a position normalized for the network (createChessPosition): the pieces of the
+ *        side to move count as white, the board is mirrored when black is to move.
+ *
+ * The side to move is left out for networks that cannot see it, so a position with black to
+ * move and its colour mirror image with white to move get the same key.
+ */
+inline std::uint64_t computeCanonicalHash(const ChessPosition &p) {
+    std::uint64_t hash = 0ULL;
+
+    auto accumulateBitboard = [&](std::uint64_t bitboard, int pieceIndex) {
+        while (bitboard) {
+            hash ^= ZOBRIST_PIECE[pieceIndex][popLSB(bitboard)];
+        }
+    };
+
+    accumulateBitboard(p.WPawn,   Z_WP);
+    accumulateBitboard(p.WKnight, Z_WN);
+    accumulateBitboard(p.WBishop, Z_WB);
+    accumulateBitboard(p.WRook,   Z_WR);
+    accumulateBitboard(p.WQueen,  Z_WQ);
+    accumulateBitboard(p.WKing,   Z_WK);
+
+    accumulateBitboard(p.BPawn,   Z_BP);
+    accumulateBitboard(p.BKnight, Z_BN);
+    accumulateBitboard(p.BBishop, Z_BB);
+    accumulateBitboard(p.BRook,   Z_BR);
+    accumulateBitboard(p.BQueen,  Z_BQ);
+    accumulateBitboard(p.BKing,   Z_BK);
+
+    // Only the linear network has the side to move and the castling rights as inputs, the
+    // convolutional ones would give the same value for every combination of them
+    if constexpr (std::is_same_v<ChessNet, ChessNetLinear>) {
+        if (!p.WhiteMove) {
+            hash ^= ZOBRIST_SIDE;
+        }
+
+        int castlingIndex = 0;
+        if (p.MyCastleL)    castlingIndex |= (1 << 0);
+        if (p.MyCastleR)    castlingIndex |= (1 << 1);
+        if (p.EnemyCastleL) castlingIndex |= (1 << 2);
+        if (p.EnemyCastleR) castlingIndex |= (1 << 3);
+        hash ^= ZOBRIST_CASTLING[castlingIndex];
+    }
+
+    std::uint64_t enPassant = p.EnPassant;
+    while (enPassant) {
+        hash ^= ZOBRIST_EN_PASSANT[popLSB(enPassant) & 7];
+    }
+
+    return hash;
+}
+
 #endif // ZOBRIST_HPP
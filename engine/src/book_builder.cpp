@@ -0,0 +1,346 @@
+// Offline opening book builder.
+//
+// Takes early positions of chess_evals.db (or a file with one FEN per line), searches each of
+// them with the Masalot search at a fixed depth on several threads and writes the chosen moves
+// as a Polyglot .bin book (16 byte big-endian records sorted by key), the format the engine
+// memory maps at startup. Every position has a single move, its weight is the search's
+// evaluation for the side to move (1 = lost .. 65535 = won), so the book still tells sound
+// lines from dubious ones.
+//
+// Usage: ./book_builder [--db ../../data/chess_evals.db] [--fens positions.txt] [--positions 5000]
+//                       [--max-move 12] [--depth 6] [--threads 8] [--model model.pt]
+//                       [--out ../../data/book.bin]
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "../include/evaluate.h"
+#include "../include/polyglot_book.h"
+
+struct BuilderOptions
+{
+    std::string db_path = "../../data/chess_evals.db";
+    std::string fens_path;
+    std::string model_path = "../../training/NN_weights/model_V1.5_C_FV_vlack_andwhite_evals_scaled_10e_weighted_lr_1e4_final.pt";
+    std::string out_path = "../../data/book.bin";
+    int positions = 5000;
+    int max_move = 12; // only positions up to this full move number count as "early"
+    int depth = 6;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+};
+
+static bool parseOptions(int argc, char **argv, BuilderOptions &options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--db") options.db_path = value;
+        else if (flag == "--fens") options.fens_path = value;
+        else if (flag == "--model") options.model_path = value;
+        else if (flag == "--out") options.out_path = value;
+        else if (flag == "--positions") options.positions = std::stoi(value);
+        else if (flag == "--max-move") options.max_move = std::stoi(value);
+        else if (flag == "--depth") options.depth = std::stoi(value);
+        else if (flag == "--threads") options.threads = std::stoi(value);
+        else
+        {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            return false;
+        }
+    }
+    if (argc % 2 == 0)
+    {
+        std::cerr << "Missing value for option " << argv[argc - 1] << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Full move number of a FEN, 1 if the field is missing
+static int fullMoveNumber(const std::string &fen)
+{
+    std::istringstream fenStream(fen);
+    std::string field;
+    int fields = 0;
+    int number = 1;
+    while (fenStream >> field)
+    {
+        if (++fields == 6)
+        {
+            number = std::atoi(field.c_str());
+        }
+    }
+    return number;
+}
+
+// SQL functions full_move(fen) and stripped_fen(fen), so sqlite filters and groups the rows itself
+static void sqlFullMove(sqlite3_context *context, int, sqlite3_value **argv)
+{
+    const unsigned char *text = sqlite3_value_text(argv[0]);
+    sqlite3_result_int(context, text == nullptr ? 0 : fullMoveNumber(reinterpret_cast<const char *>(text)));
+}
+
+static void sqlStrippedFen(sqlite3_context *context, int, sqlite3_value **argv)
+{
+    const unsigned char *text = sqlite3_value_text(argv[0]);
+    if (text == nullptr)
+    {
+        sqlite3_result_null(context);
+        return;
+    }
+    std::string stripped = stripFen(reinterpret_cast<const char *>(text));
+    sqlite3_result_text(context, stripped.c_str(), static_cast<int>(stripped.size()), SQLITE_TRANSIENT);
+}
+
+/**
+ * @brief Early positions of the evaluations table (up to --max-move), at most --positions of them.
+ *        FENs in the database are unique, it holds no game counts: a position only repeats when
+ *        it was reached along move orders of different length (other clocks). Positions reached
+ *        most often that way come first, then the earliest ones.
+ */
+static std::vector<std::string> loadEarlyPositions(const BuilderOptions &options)
+{
+    std::vector<std::string> positions;
+
+    sqlite3 *db;
+    if (sqlite3_open_v2(options.db_path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Cannot open database: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return positions;
+    }
+    sqlite3_create_function(db, "full_move", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, sqlFullMove, nullptr, nullptr);
+    sqlite3_create_function(db, "stripped_fen", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, sqlStrippedFen, nullptr, nullptr);
+
+    sqlite3_stmt *stmt;
+    const char *sql = "SELECT MIN(fen), COUNT(*) AS reached FROM evaluations "
+                      "WHERE full_move(fen) <= ? "
+                      "GROUP BY stripped_fen(fen) "
+                      "ORDER BY reached DESC, MIN(full_move(fen)) ASC "
+                      "LIMIT ?";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return positions;
+    }
+    sqlite3_bind_int(stmt, 1, options.max_move);
+    sqlite3_bind_int(stmt, 2, options.positions);
+
+    int repeated = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char *text = sqlite3_column_text(stmt, 0);
+        if (text != nullptr)
+        {
+            positions.emplace_back(reinterpret_cast<const char *>(text));
+            repeated += sqlite3_column_int(stmt, 1) > 1;
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    std::cout << "Early positions: " << positions.size() << ", " << repeated << " of them reached with different clocks" << std::endl;
+    return positions;
+}
+
+static std::vector<std::string> loadFenFile(const std::string &path)
+{
+    std::vector<std::string> positions;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            positions.push_back(line);
+        }
+    }
+    return positions;
+}
+
+// Board of a FEN as 64 chars, a1 = 0, h8 = 63
+static void parseBoard(const std::string &fen, char board[64])
+{
+    std::fill(board, board + 64, ' ');
+    int row = 7;
+    int file = 0;
+    for (char c : fen.substr(0, fen.find(' ')))
+    {
+        if (c == '/') { row--; file = 0; }
+        else if (c >= '1' && c <= '8') file += c - '0';
+        else if (row >= 0 && file < 8) board[8 * row + file++] = c;
+    }
+}
+
+/**
+ * @brief UCI move that leads from before to after (the search answers with the resulting FEN).
+ *        For castling the king move is returned, for promotions the promoted piece is appended.
+ */
+static std::string uciBetween(const std::string &before, const std::string &after)
+{
+    char a[64], b[64];
+    parseBoard(before, a);
+    parseBoard(after, b);
+    const bool white = isWhite(before);
+    auto own = [white](char c) { return c != ' ' && (std::isupper(static_cast<unsigned char>(c)) != 0) == white; };
+
+    int from = -1, to = -1;
+    for (int sq = 0; sq < 64; sq++)
+    {
+        if (own(a[sq]) && a[sq] != b[sq] && (from < 0 || std::tolower(a[sq]) == 'k'))
+        {
+            from = sq;
+        }
+    }
+    for (int sq = 0; sq < 64; sq++)
+    {
+        if (own(b[sq]) && a[sq] != b[sq] && (to < 0 || std::tolower(b[sq]) == 'k'))
+        {
+            to = sq;
+        }
+    }
+    if (from < 0 || to < 0)
+    {
+        return "";
+    }
+
+    std::string uci{static_cast<char>('a' + from % 8), static_cast<char>('1' + from / 8),
+                    static_cast<char>('a' + to % 8), static_cast<char>('1' + to / 8)};
+    if (std::tolower(a[from]) == 'p' && std::tolower(b[to]) != 'p')
+    {
+        uci += static_cast<char>(std::tolower(b[to]));
+    }
+    return uci;
+}
+
+// Search evaluation (White's view, -1..1) as a Polyglot weight for the side to move, never 0
+static uint16_t bookWeight(float eval, bool white_to_move)
+{
+    const float own = std::clamp(white_to_move ? eval : -eval, -1.0f, 1.0f);
+    return static_cast<uint16_t>(std::max(1L, std::lround((own + 1.0f) * 32767.5f)));
+}
+
+static void writeBook(const std::string &path, std::vector<PolyglotEntry> &entries)
+{
+    std::sort(entries.begin(), entries.end(),
+              [](const PolyglotEntry &a, const PolyglotEntry &b)
+              { return a.key != b.key ? a.key < b.key : a.weight > b.weight; });
+
+    std::ofstream out(path, std::ios::binary);
+    for (const auto &entry : entries)
+    {
+        unsigned char record[16];
+        for (int i = 0; i < 8; i++) record[i] = static_cast<unsigned char>(entry.key >> (56 - 8 * i));
+        record[8] = static_cast<unsigned char>(entry.move >> 8);
+        record[9] = static_cast<unsigned char>(entry.move);
+        record[10] = static_cast<unsigned char>(entry.weight >> 8);
+        record[11] = static_cast<unsigned char>(entry.weight);
+        for (int i = 0; i < 4; i++) record[12 + i] = static_cast<unsigned char>(entry.learn >> (24 - 8 * i));
+        out.write(reinterpret_cast<const char *>(record), 16);
+    }
+    std::cout << "Wrote " << entries.size() << " book entries to " << path << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    BuilderOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    std::vector<std::string> positions = options.fens_path.empty() ? loadEarlyPositions(options)
+                                                                   : loadFenFile(options.fens_path);
+    if (positions.empty())
+    {
+        std::cerr << "No positions to analyse" << std::endl;
+        return 1;
+    }
+
+    // Load the model once, all workers share it (inference only)
+    torch::NoGradGuard no_grad;
+    auto model = ChessNet();
+    try
+    {
+        torch::serialize::InputArchive input_archive;
+        input_archive.load_from(options.model_path);
+        model->load(input_archive);
+        model->eval();
+        if (torch::cuda::is_available())
+        {
+            model->to(torch::kCUDA); // Before the workers start, each of them would otherwise move it
+        }
+    }
+    catch (const c10::Error &e)
+    {
+        std::cerr << "Error loading model weights: " << e.what() << std::endl;
+        return 1;
+    }
+    // Parallelism comes from the workers, one intra-op thread each
+    torch::set_num_threads(1);
+
+    std::atomic<std::size_t> next{0};
+    std::mutex entries_mutex;
+    std::vector<PolyglotEntry> entries;
+
+    // Network outputs are shared by all workers, transpositions between the book positions are common
+    EvalCache evaluations_map;
+
+    auto worker = [&]()
+    {
+        torch::NoGradGuard worker_no_grad;
+        SearchSession session;
+        session.use_book = false;
+        session.use_cloud_database = false;
+        session.prune_eval_cache = false; // the cache serves every book position
+
+        for (std::size_t i = next++; i < positions.size(); i = next++)
+        {
+            const std::string &fen = positions[i];
+            std::unordered_set<std::string> previous_positions;
+            bestMoveInfo info = search_best_move(model, fen, options.depth, evaluations_map, previous_positions, session);
+
+            std::string uci = uciBetween(fen, info.move);
+            if (uci.empty())
+            {
+                std::cerr << "No move for " << fen << std::endl;
+                continue;
+            }
+
+            PolyglotEntry entry{polyglotKey(fen), polyglotMove(uci, fen), bookWeight(info.eval, isWhite(fen)), 0};
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            entries.push_back(entry);
+            std::cout << "[" << entries.size() << "/" << positions.size() << "] " << fen << " -> " << uci
+                      << " (eval " << info.eval << ", depth " << info.depth << ")" << std::endl;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+
+    writeBook(options.out_path, entries);
+    return 0;
+}
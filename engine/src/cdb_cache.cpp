@@ -0,0 +1,237 @@
+#include "../include/cdb_cache.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// --------------------------------------------------
+// File layout: 64 byte header, then the slots
+// --------------------------------------------------
+static const char CACHE_MAGIC[8] = {'M', 'S', 'L', 'C', 'D', 'B', '0', '1'};
+static constexpr std::size_t HEADER_BYTES = 64;
+static constexpr int PROBE_LIMIT = 16; // slots looked at from the home slot on
+
+struct CacheHeader
+{
+    char magic[8];
+    std::uint64_t slot_count;
+    std::uint64_t slot_bytes;
+};
+
+// Holds a flock on the cache file while it lives: the in-process mutex does not stop other engine
+// processes mapping the same file from tearing a probe sequence
+struct FileLock
+{
+    int fd;
+    FileLock(int fd, int operation) : fd(fd)
+    {
+        while (flock(fd, operation) != 0 && errno == EINTR)
+        {
+        }
+    }
+    ~FileLock() { flock(fd, LOCK_UN); }
+};
+
+static std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+CloudDatabaseCache::~CloudDatabaseCache()
+{
+    close();
+}
+
+bool CloudDatabaseCache::open(const std::string &path, std::size_t slot_count)
+{
+    close();
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0)
+    {
+        std::cerr << "Error: cloud database cache size must be a power of two" << std::endl;
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot open cloud database cache " << path << std::endl;
+        return false;
+    }
+
+    // Exclusive while checking and initializing, another process may be opening the same file
+    const std::size_t bytes = HEADER_BYTES + slot_count * sizeof(Slot);
+    while (flock(fd, LOCK_EX) != 0 && errno == EINTR)
+    {
+    }
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) == bytes;
+    if (valid)
+    {
+        CacheHeader header;
+        valid = pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+                std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                header.slot_count == slot_count && header.slot_bytes == sizeof(Slot);
+    }
+    if (!valid)
+    {
+        // New file or another layout: start empty (ftruncate zero fills, zero keys are empty slots)
+        CacheHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.slot_count = slot_count;
+        header.slot_bytes = sizeof(Slot);
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, bytes) != 0 ||
+            pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+        {
+            std::cerr << "Error: cannot initialize cloud database cache " << path << std::endl;
+            flock(fd, LOCK_UN);
+            ::close(fd);
+            return false;
+        }
+    }
+
+    void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    flock(fd, LOCK_UN);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Error: failed to mmap cloud database cache " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    // The descriptor stays open for the locks of probe and store
+    std::lock_guard<std::mutex> lock(mutex);
+    lock_fd = fd;
+    mapping = static_cast<unsigned char *>(map);
+    mapped_bytes = bytes;
+    slots = reinterpret_cast<Slot *>(mapping + HEADER_BYTES);
+    mask = slot_count - 1;
+    std::cout << "Cloud database cache: " << path << (valid ? "" : " (new)") << std::endl;
+    return true;
+}
+
+void CloudDatabaseCache::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mapped_bytes);
+    }
+    if (lock_fd >= 0)
+    {
+        ::close(lock_fd);
+    }
+    lock_fd = -1;
+    mapping = nullptr;
+    mapped_bytes = 0;
+    slots = nullptr;
+    mask = 0;
+}
+
+// FNV-1a of the stripped FEN, stable between runs (std::hash is not guaranteed to be)
+std::uint64_t CloudDatabaseCache::keyOf(const std::string &fen)
+{
+    std::istringstream fenStream(fen);
+    std::string board, turn, castling, enPassant;
+    fenStream >> board >> turn >> castling >> enPassant;
+    const std::string stripped = board + " " + turn + " " + castling + " " + enPassant;
+
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : stripped)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+bool CloudDatabaseCache::probe(const std::string &fen, std::string &move)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slots == nullptr)
+    {
+        return false;
+    }
+
+    const std::uint64_t key = keyOf(fen);
+    FileLock file_lock(lock_fd, LOCK_SH);
+    for (int i = 0; i < PROBE_LIMIT; i++)
+    {
+        const Slot &slot = slots[(key + i) & mask];
+        if (slot.key == 0)
+        {
+            return false;
+        }
+        if (slot.key == key)
+        {
+            if (slot.expires <= now())
+            {
+                return false;
+            }
+            std::size_t length = strnlen(slot.move, sizeof(slot.move));
+            move = length == 0 ? "nobestmove" : std::string(slot.move, length);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CloudDatabaseCache::store(const std::string &fen, const std::string &move)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slots == nullptr)
+    {
+        return;
+    }
+
+    const std::int64_t time = now();
+    const std::uint64_t key = keyOf(fen);
+    FileLock file_lock(lock_fd, LOCK_EX);
+
+    // Same key or the first empty slot, else the slot expiring first (expired ones go first)
+    Slot *target = &slots[key & mask];
+    for (int i = 0; i < PROBE_LIMIT; i++)
+    {
+        Slot &slot = slots[(key + i) & mask];
+        if (slot.key == key || slot.key == 0)
+        {
+            target = &slot;
+            break;
+        }
+        if (slot.expires < target->expires)
+        {
+            target = &slot;
+        }
+    }
+
+    const bool noMove = (move == "nobestmove" || move.size() >= sizeof(target->move));
+    std::memset(target->move, 0, sizeof(target->move));
+    if (!noMove)
+    {
+        std::memcpy(target->move, move.data(), move.size());
+    }
+    target->expires = time + (noMove ? NO_MOVE_TTL_S : MOVE_TTL_S);
+    target->reserved = 0;
+    target->key = key;
+}
+
+// --------------------------------------------------
+// Process wide cache
+// --------------------------------------------------
+CloudDatabaseCache &cloudDatabaseCache()
+{
+    static CloudDatabaseCache cache;
+    return cache;
+}
+
+bool openCloudDatabaseCache(const std::string &path)
+{
+    return cloudDatabaseCache().open(path);
+}
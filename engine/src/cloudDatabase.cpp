@@ -1,8 +1,14 @@
+#include "../include/cloudDatabase.h"
+#include "../include/cdb_cache.h"
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <curl/curl.h>
 
+static const char *DEFAULT_CDB_URL = "http://www.chessdb.cn/cdb.php"; // override with MASALOT_CDB_URL (e.g. a local stub server)
+static const long DEFAULT_CDB_TIMEOUT_MS = 2000;                      // override with MASALOT_CDB_TIMEOUT_MS
+
 // --------------------------------------------------
 // Callback to write data from cURL into an std::string
 // --------------------------------------------------
@@ -112,6 +118,23 @@ static std::string removeAllWhitespace(const std::string& str)
 // }
 
 
+// Something like "e2e4" or "e7e8q", anything else from the server is not trusted as a move
+static bool looksLikeUciMove(const std::string &move)
+{
+    if (move.size() != 4 && move.size() != 5)
+    {
+        return false;
+    }
+    for (int i = 0; i < 4; i += 2)
+    {
+        if (move[i] < 'a' || move[i] > 'h' || move[i + 1] < '1' || move[i + 1] > '8')
+        {
+            return false;
+        }
+    }
+    return move.size() == 4 || std::string("nbrq").find(move[4]) != std::string::npos;
+}
+
 static std::string parseBestMove(std::string &response)
 {
     // 1) Optionally remove the trailing character if the string isn't empty.
@@ -165,7 +188,7 @@ static std::string parseBestMove(std::string &response)
             while(!theMove.empty() && theMove.back()  == ' ') theMove.pop_back();
         }
 
-        return theMove;
+        return looksLikeUciMove(theMove) ? theMove : "nobestmove";
     }
 
     // If we reach here, we didn't find "move:"
@@ -180,77 +203,171 @@ static std::string parseBestMove(std::string &response)
             : response.substr(0, end);
 
         // Basic check: is it at least 4 chars to look like "e2e4" etc.
-        if (potentialMove.size() >= 4 && potentialMove.size() <= 5) {
+        if (looksLikeUciMove(potentialMove)) {
             return potentialMove; 
         }
     }
 
-    // If none of the above matched, return Error
-    return "Error";
+    // If none of the above matched there is no move to play
+    std::cout << "Database response not understood: " << response << std::endl;
+    return "nobestmove";
 }
 
 // --------------------------------------------------
-// Main function to call "querybest" and return best move
+// Asynchronous lookup
 // --------------------------------------------------
-std::string getBestMoveFromCDB(const std::string& fen)
+CloudDatabaseLookup::CloudDatabaseLookup()
 {
-    // --- 1) Build request URL ---
-    // Make sure to URL-encode the FEN properly. Here we assume
-    // the spaces in FEN are replaced by "%20".
-    // Also, we use:
-    //   action=querybest
-    //   board=[fen]
-    //   endgame=0
-    //   egtbmetric=dtz
-    //   learn=1
-    //
-    // You can add or remove parameters as needed.
-    // std::string baseUrl = "http://www.chessdb.cn/cdb.php?action=querybest&board=";
-    std::string baseUrl = "http://www.chessdb.cn/cdb.php?action=queryall&board=";
-    // std::string url = baseUrl + "&board=" + fen + "&endgame=0&egtbmetric=dtz&learn=1";
-
-    std::string fenEncoded = encodeSpaces(fen);
-// "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR%20w%20KQkq%20-%200%201"
-
-std::string url = baseUrl
-                + fenEncoded;
-                // + "&endgame=0&egtbmetric=dtz&learn=1";
-
-    // --- 2) Initialize cURL and set options ---
-    CURL* curl = curl_easy_init();
-    if (!curl)
+    const char *url = std::getenv("MASALOT_CDB_URL");
+    base_url = std::string(url != nullptr ? url : DEFAULT_CDB_URL) + "?action=queryall&board=";
+
+    const char *timeout = std::getenv("MASALOT_CDB_TIMEOUT_MS");
+    timeout_ms = timeout != nullptr ? std::atol(timeout) : DEFAULT_CDB_TIMEOUT_MS;
+
+    easy = curl_easy_init();
+    multi = curl_multi_init();
+    if (!easy || !multi)
     {
         std::cerr << "Error: failed to initialize libcurl.\n";
-        return "nobestmove";
     }
+}
 
-    // This will store the server's raw response
-    std::string response;
+CloudDatabaseLookup::~CloudDatabaseLookup()
+{
+    finish();
+    if (multi)
+    {
+        curl_multi_cleanup(multi);
+    }
+    if (easy)
+    {
+        curl_easy_cleanup(easy);
+    }
+}
 
+bool CloudDatabaseLookup::start(const std::string &fen, std::function<void()> on_move)
+{
+    finish();
+    move = "nobestmove";
+    cancelled = false;
+    if (cloudDatabaseCache().probe(fen, move))
+    {
+        return true;
+    }
+    if (!easy || !multi)
+    {
+        return false;
+    }
+    this->fen = fen;
+
+    // The easy handle lives as long as the lookup object, so its connection stays open between moves
+    this->on_move = std::move(on_move);
+    curl_easy_setopt(easy, CURLOPT_URL, (base_url + encodeSpaces(fen)).c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(easy, CURLOPT_USERAGENT, "MyChessClient/1.0");
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    response.clear();
+
+    worker = std::thread(&CloudDatabaseLookup::run, this);
+    return false;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    // Optional: set a custom user-agent
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "MyChessClient/1.0");
+void CloudDatabaseLookup::run()
+{
+    curl_multi_add_handle(multi, easy);
 
-    // --- 3) Perform the request ---
-    CURLcode res = curl_easy_perform(curl);
+    bool finished = false;
+    CURLcode result = CURLE_OK;
+    while (!cancelled && !finished)
+    {
+        int running = 0;
+        if (curl_multi_perform(multi, &running) != CURLM_OK)
+        {
+            break;
+        }
 
-    // --- 4) Clean up cURL ---
-    curl_easy_cleanup(curl);
+        int queued = 0;
+        while (CURLMsg *message = curl_multi_info_read(multi, &queued))
+        {
+            if (message->msg == CURLMSG_DONE)
+            {
+                finished = true;
+                result = message->data.result;
+            }
+        }
+
+        if (!finished)
+        {
+            // Woken up early by curl_multi_wakeup when the lookup is cancelled
+            curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        }
+    }
+    curl_multi_remove_handle(multi, easy);
 
-    // If the request failed at the transport level, handle it
-    if (res != CURLE_OK)
+    if (!finished)
     {
-        std::cerr << "cURL error: " << curl_easy_strerror(res) << "\n";
-        return "nobestmove";
+        return;
+    }
+    if (result != CURLE_OK)
+    {
+        std::cerr << "cURL error: " << curl_easy_strerror(result) << "\n";
+        return;
     }
 
-    // std::cout << "response raw: " << response << std::endl;
+    // Cached even if the search does not wait for it, transport errors are not answers
+    std::string best = parseBestMove(response);
+    cloudDatabaseCache().store(fen, best);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cancelled || best == "nobestmove")
+    {
+        return;
+    }
+    move = best;
+    if (on_move)
+    {
+        on_move();
+    }
+}
+
+std::string CloudDatabaseLookup::wait()
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    on_move = nullptr;
+    return move;
+}
+
+std::string CloudDatabaseLookup::finish()
+{
+    {
+        // After this on_move can no longer be called
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+    }
+    if (multi)
+    {
+        curl_multi_wakeup(multi);
+    }
+    return wait();
+}
+
+// --------------------------------------------------
+// Main function to call "queryall" and return best move
+// --------------------------------------------------
+std::string getBestMoveFromCDB(const std::string& fen)
+{
+    static CloudDatabaseLookup lookup;
+    static std::mutex lookup_mutex;
+    std::lock_guard<std::mutex> lock(lookup_mutex);
 
-    // --- 5) Parse the response for the best move ---
-    return parseBestMove(response);
+    lookup.start(fen);
+    return lookup.wait();
 }
 
 // --------------------------------------------------
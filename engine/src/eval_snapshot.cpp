@@ -0,0 +1,150 @@
+#include "../include/eval_snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// --------------------------------------------------
+// File layout: 64 byte header, then one 8 byte packed entry per slot of the cache
+// --------------------------------------------------
+static const char SNAPSHOT_MAGIC[8] = {'M', 'S', 'L', 'E', 'V', 'C', '0', '1'};
+static constexpr std::size_t HEADER_BYTES = 64;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint64_t entry_count;
+    std::uint64_t fingerprint;
+};
+
+EvalCacheSnapshots::EvalCacheSnapshots(EvalCache &cache, const std::string &path, std::uint64_t fingerprint, int interval_s)
+    : cache(cache), path(path), fingerprint(fingerprint), interval(interval_s),
+      last_save(std::chrono::steady_clock::now())
+{
+}
+
+EvalCacheSnapshots::~EvalCacheSnapshots()
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    save();
+}
+
+std::size_t EvalCacheSnapshots::load()
+{
+    if (cache.size() != 0)
+    {
+        return 0; // a shared cache another process has already warmed up
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    const std::size_t bytes = HEADER_BYTES + cache.capacity() * sizeof(std::uint64_t);
+    struct stat st;
+    SnapshotHeader header;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != bytes ||
+        pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.entry_count != cache.capacity())
+    {
+        std::cerr << "Ignoring evaluation cache snapshot " << path << " of another cache size" << std::endl;
+        ::close(fd);
+        return 0;
+    }
+    if (header.fingerprint != fingerprint)
+    {
+        std::cout << "Ignoring evaluation cache snapshot " << path << " of other network weights" << std::endl;
+        ::close(fd);
+        return 0;
+    }
+
+    void *map = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Error: failed to mmap evaluation cache snapshot " << path << std::endl;
+        return 0;
+    }
+    madvise(map, bytes, MADV_SEQUENTIAL);
+
+    const auto *entries = reinterpret_cast<const std::uint64_t *>(static_cast<const unsigned char *>(map) + HEADER_BYTES);
+    for (std::size_t i = 0; i < cache.capacity(); i++)
+    {
+        cache.restore(i, entries[i]);
+    }
+    munmap(map, bytes);
+
+    std::cout << "Evaluation cache snapshot loaded: " << cache.size() << " evaluations" << std::endl;
+    return cache.size();
+}
+
+void EvalCacheSnapshots::saveInBackground()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (saving.load() || now - last_save < interval)
+    {
+        return;
+    }
+    if (worker.joinable())
+    {
+        worker.join(); // finished already
+    }
+    last_save = now;
+    saving.store(true);
+    worker = std::thread([this]()
+                         {
+                             save();
+                             saving.store(false); });
+}
+
+bool EvalCacheSnapshots::save()
+{
+    if (cache.size() == 0)
+    {
+        return false;
+    }
+
+    // Per process, several servers may snapshot the same shared cache
+    const std::string temporary = path + ".tmp." + std::to_string(getpid());
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    unsigned char header[HEADER_BYTES] = {};
+    SnapshotHeader fields{};
+    std::memcpy(fields.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    fields.entry_count = cache.capacity();
+    fields.fingerprint = fingerprint;
+    std::memcpy(header, &fields, sizeof(fields));
+    out.write(reinterpret_cast<const char *>(header), HEADER_BYTES);
+
+    // Chunks of entries, each read atomically: entries written meanwhile are either in or not
+    std::vector<std::uint64_t> chunk(1 << 16);
+    for (std::size_t start = 0; start < cache.capacity() && out; start += chunk.size())
+    {
+        const std::size_t count = std::min(chunk.size(), cache.capacity() - start);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            chunk[i] = cache.raw(start + i);
+        }
+        out.write(reinterpret_cast<const char *>(chunk.data()), count * sizeof(std::uint64_t));
+    }
+    out.close();
+
+    if (!out || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Error: cannot write evaluation cache snapshot " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -1,12 +1,20 @@
 #include "../include/move_gen.h"
 #include "../include/evaluate.h"
 #include "../include/cloudDatabase.h"
+#include "../include/polyglot_book.h"
+#include "../include/syzygy.h"
 #include "../giga/Gigantua.hpp"
+#include "../../training/include/frozen_model.h"
 #include <algorithm>  // For std::shuffle
 #include <random>    
 #include <iostream>
 #include <limits>
+#include <cmath>
 #include <future>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <type_traits>
 
 bool isWhite(const std::string &fen)
 {
@@ -97,6 +105,417 @@ std::string stripFen(const std::string &fen) {
 }
 
 
+// Zobrist key of a FEN, the same key MoveReceiver uses for the node in the search
+static uint64_t hashFen(const std::string &fen)
+{
+    static const bool keys_ready = (initZobristKeys(), true);
+    (void)keys_ready;
+
+    std::string_view view(fen);
+    BoardStatus status(FEN::FenInfo<FenField::white>(view),
+                       FEN::FenInfo<FenField::hasEP>(view),
+                       FEN::FenInfo<FenField::WCastleL>(view),
+                       FEN::FenInfo<FenField::WCastleR>(view),
+                       FEN::FenInfo<FenField::BCastleL>(view),
+                       FEN::FenInfo<FenField::BCastleR>(view));
+    return computeZobristHash(Board(view), status, FEN::FenEnpassant(view));
+}
+
+uint64_t modelFingerprint(ChessNet &model)
+{
+    return weightsFingerprint(*model);
+}
+
+// FNV-1a, continued from hash
+static uint64_t fnv1a(const void *data, std::size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Hash of a weight file's bytes: two quantizations of one model differ although both carry its fingerprint
+static uint64_t fileFingerprint(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return fnv1a(bytes.data(), bytes.size());
+}
+
+// What evaluates the leaves, set by the enable functions below. 0 = the model through libtorch.
+static uint64_t leaf_backend = 0;
+
+uint64_t evalCacheFingerprint(ChessNet &model)
+{
+    uint64_t backend = leaf_backend;
+    if (backend == 0)
+    {
+        // cuDNN may use TF32, its outputs are not the CPU ones
+        const std::string device = model->parameters().front().device().is_cuda() ? "libtorch cuda" : "libtorch cpu";
+        backend = fnv1a(device.data(), device.size());
+    }
+    const uint64_t weights = modelFingerprint(model);
+    return fnv1a(&backend, sizeof(backend), fnv1a(&weights, sizeof(weights)));
+}
+
+// Only the convolutional network has a folded form
+template <class Net>
+static bool exportFoldedWeights(Net &model, const std::string &path, uint64_t fingerprint)
+{
+    if constexpr (std::is_same_v<Net, ChessNetConv>)
+    {
+        return model->exportFolded(path, fingerprint);
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Every network but NNUEHalfKP has a folded form
+template <class Net>
+static std::vector<FoldedLayer> foldedLayersOf(Net &model)
+{
+    if constexpr (std::is_same_v<Net, NNUEHalfKP>)
+    {
+        return {};
+    }
+    else
+    {
+        return model->foldedLayers();
+    }
+}
+
+// Normalized network input of a FEN, as MoveReceiver::evaluate builds it
+static ChessPosition positionOfFen(const std::string &fen)
+{
+    std::string_view view(fen);
+    BoardStatus status(FEN::FenInfo<FenField::white>(view),
+                       FEN::FenInfo<FenField::hasEP>(view),
+                       FEN::FenInfo<FenField::WCastleL>(view),
+                       FEN::FenInfo<FenField::WCastleR>(view),
+                       FEN::FenInfo<FenField::BCastleL>(view),
+                       FEN::FenInfo<FenField::BCastleR>(view));
+    return createChessPosition(Board(view), status, FEN::FenEnpassant(view));
+}
+
+// Largest difference between the model and another forward pass on a few test positions,
+// and the root mean square one if rms is given
+template <class Forward>
+static float largestDifference(ChessNet &model, Forward &&forward, float *rms = nullptr)
+{
+    const std::vector<std::string> fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "r3k2r/pp1n1ppp/2p1pn2/q2p4/2PP4/2N1PN2/PP1Q1PPP/R3KB1R b KQkq - 1 10",
+        "8/5pk1/6p1/3R4/6P1/5K2/r7/8 b - - 3 45"};
+    const torch::Device device = model->parameters().front().device();
+    float worst = 0.0f;
+    float squares = 0.0f;
+    for (const auto &fen : fens)
+    {
+        ChessPosition position = positionOfFen(fen);
+        float expected = model->forward(model->toTensor(position).unsqueeze(0).to(device)).item<float>();
+        const float difference = std::abs(expected - forward(position));
+        worst = std::max(worst, difference);
+        squares += difference * difference;
+    }
+    if (rms != nullptr)
+    {
+        *rms = std::sqrt(squares / fens.size());
+    }
+    return worst;
+}
+
+bool enableCpuInference(ChessNet &model, const std::string &path)
+{
+    static std::mutex setup;
+    static ConvInference::Network network; // MoveReceiver::cpu_network points here for the rest of the process
+    std::lock_guard<std::mutex> lock(setup);
+    if (MoveReceiver::cpu_network != nullptr)
+    {
+        return true;
+    }
+
+    torch::NoGradGuard no_grad;
+    model->eval();
+    const uint64_t fingerprint = modelFingerprint(model);
+    if (!network.load(path, fingerprint))
+    {
+        if (!exportFoldedWeights(model, path, fingerprint) || !network.load(path, fingerprint))
+        {
+            std::cerr << "CPU inference unavailable, cannot write folded weights " << path << std::endl;
+            return false;
+        }
+        std::cout << "Folded network weights written to " << path << std::endl;
+    }
+
+    // Summation order differs from libtorch (and cuDNN may use TF32), so agreement is within a tolerance
+    constexpr float TOLERANCE = 5e-3f;
+    // The search starts the leaves from the conv1 accumulator, checked as well
+    const float worst = std::max(largestDifference(model, [](const ChessPosition &position)
+                                                   { return MoveReceiver::cpuForward(network, position); }),
+                                 largestDifference(model, [](const ChessPosition &position)
+                                                   { return MoveReceiver::cpuAccumulatedForward(network, position); }));
+    if (worst > TOLERANCE)
+    {
+        std::cerr << "CPU inference disabled, it differs from the model by " << worst << std::endl;
+        return false;
+    }
+
+    MoveReceiver::cpu_network = &network;
+    leaf_backend = fnv1a("cpu", 3, fileFingerprint(path));
+    std::cout << "CPU inference enabled (largest difference to the model " << worst << ")" << std::endl;
+    return true;
+}
+
+bool enableInt8Inference(ChessNet &model, const std::string &path)
+{
+    static std::mutex setup;
+    static Int8Inference::Network network; // MoveReceiver::int8_network points here for the rest of the process
+    std::lock_guard<std::mutex> lock(setup);
+    if (MoveReceiver::int8_network != nullptr)
+    {
+        return true;
+    }
+
+    torch::NoGradGuard no_grad;
+    model->eval();
+    if (!network.load(path, modelFingerprint(model)))
+    {
+        return false; // Not quantized yet (testing or training --qat writes the file) or of other weights
+    }
+
+    // A sound quantization stays around 1e-2 from the float outputs (tanh, -1..1), the range the
+    // accuracy report of testing shows. A file further off is badly calibrated or of a drifted QAT run.
+    constexpr float TOLERANCE = 2e-2f;     // any single position
+    constexpr float RMS_TOLERANCE = 1e-2f; // over the test positions
+    float rms = 0.0f;
+    const float worst = largestDifference(model, [](const ChessPosition &position)
+                                          { return MoveReceiver::int8Forward(network, position); },
+                                          &rms);
+    if (worst > TOLERANCE || rms > RMS_TOLERANCE)
+    {
+        std::cerr << "Int8 inference disabled, it differs from the model by up to " << worst << " (rms " << rms << ")" << std::endl;
+        return false;
+    }
+
+    MoveReceiver::int8_network = &network;
+    leaf_backend = fnv1a("int8", 4, fileFingerprint(path));
+    std::cout << "Int8 inference enabled (largest difference to the model " << worst << ", rms " << rms << ")" << std::endl;
+    return true;
+}
+
+// Microseconds per call of the model and of its frozen copy at batch 1 and 64
+static void reportFrozenLatency(ChessNet &model, torch::jit::Module &frozen, torch::Device device)
+{
+    constexpr int ITERATIONS = 50;
+    const torch::Tensor position = model->toTensor(positionOfFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+    for (int64_t batch : {1, 64})
+    {
+        const torch::Tensor input = position.unsqueeze(0).repeat_interleave(batch, 0).to(device);
+        // Reading the output back waits for the device, as a search does
+        auto microseconds = [](auto &&run)
+        {
+            run().cpu();
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < ITERATIONS; i++)
+            {
+                run().cpu();
+            }
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+        };
+        const double eager = microseconds([&]
+                                          {
+                                              torch::NoGradGuard no_grad;
+                                              return model->forward(input); });
+        const double frozen_us = microseconds([&]
+                                              {
+                                                  c10::InferenceMode inference;
+                                                  return frozen.forward({input}).toTensor(); });
+        std::cout << "Batch " << batch << ": model " << eager << " us, frozen model " << frozen_us << " us" << std::endl;
+    }
+}
+
+bool enableFrozenModel(ChessNet &model, const std::string &path)
+{
+    static std::mutex setup;
+    static torch::jit::Module frozen; // MoveReceiver::frozen_model points here for the rest of the process
+    std::lock_guard<std::mutex> lock(setup);
+    if (MoveReceiver::frozen_model != nullptr)
+    {
+        return true;
+    }
+
+    torch::NoGradGuard no_grad;
+    model->eval();
+    const uint64_t fingerprint = modelFingerprint(model);
+    const torch::Device device = model->parameters().front().device();
+    if (!loadFrozen(path, fingerprint, device, frozen))
+    {
+        const std::vector<FoldedLayer> layers = foldedLayersOf(model);
+        if (layers.empty() || !exportFrozen(layers, path, fingerprint) || !loadFrozen(path, fingerprint, device, frozen))
+        {
+            std::cerr << "Frozen model unavailable, cannot write " << path << std::endl;
+            return false;
+        }
+        std::cout << "Frozen model written to " << path << std::endl;
+    }
+
+    constexpr float TOLERANCE = 5e-3f;
+    const float worst = largestDifference(model, [&](const ChessPosition &position)
+                                          {
+                                              c10::InferenceMode inference;
+                                              torch::Tensor input = model->toTensor(position).unsqueeze(0).to(device);
+                                              return frozen.forward({input}).toTensor().item<float>(); });
+    if (worst > TOLERANCE)
+    {
+        std::cerr << "Frozen model disabled, it differs from the model by " << worst << std::endl;
+        return false;
+    }
+
+    reportFrozenLatency(model, frozen, device);
+    MoveReceiver::frozen_model = &frozen;
+    const std::string frozen_device = device.is_cuda() ? "frozen cuda" : "frozen cpu";
+    leaf_backend = fnv1a(frozen_device.data(), frozen_device.size(), fileFingerprint(path));
+    std::cout << "Frozen model enabled (largest difference to the model " << worst << ")" << std::endl;
+    return true;
+}
+
+bool enableNnueInference(const std::string &path)
+{
+    static std::mutex setup;
+    static NNUEInference::Network network; // MoveReceiver::nnue_network points here for the rest of the process
+    std::lock_guard<std::mutex> lock(setup);
+    if (MoveReceiver::nnue_network != nullptr)
+    {
+        return true;
+    }
+    if (!network.load(path))
+    {
+        return false; // Not exported yet (training writes it when ChessNet is NNUEHalfKP) or of another shape
+    }
+
+    // The search keeps the accumulators of the boards it plays, nothing to compare against the model here
+    NNUEInference::Accumulator accumulator;
+    std::string_view start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    Board start(start_fen);
+    MoveReceiver::nnueRefresh(network, start, accumulator);
+    const float value = network.evaluate(accumulator, true);
+    if (!std::isfinite(value))
+    {
+        std::cerr << "NNUE inference disabled, " << path << " is damaged" << std::endl;
+        return false;
+    }
+
+    MoveReceiver::nnue_network = &network;
+    leaf_backend = fnv1a("nnue", 4, fileFingerprint(path));
+    std::cout << "NNUE inference enabled (start position " << value << ")" << std::endl;
+    return true;
+}
+
+// Reachability signature of a FEN for pruning the evaluation cache
+static uint16_t evalSignature(const std::string &fen)
+{
+    Board board{std::string_view(fen)};
+    return EvalCache::signature(board.Occ, board.WPawn, board.BPawn);
+}
+
+// (from | to) mask of the move played between two positions, as stored in the transposition table.
+// For castling this is kingswitch | rookswitch, for promotions and en passant it is still from | to.
+static uint64_t moveMask(const std::string &before_fen, const std::string &after_fen, bool white)
+{
+    Board before{std::string_view(before_fen)};
+    Board after{std::string_view(after_fen)};
+    return white ? (before.White ^ after.White) : (before.Black ^ after.Black);
+}
+
+// Board, side to move and castling rights. Clocks and the en passant field are ignored,
+// clients do not agree on when to write the en passant square.
+std::string positionKey(const std::string &fen)
+{
+    std::istringstream fenStream(fen);
+    std::string board, turn, castling;
+    fenStream >> board >> turn >> castling;
+    return board + " " + turn + " " + castling;
+}
+
+/**
+ * @brief Checks if pos can be reached from root in one or two plies.
+ */
+static bool isDescendant(const std::string &root, const std::string &pos)
+{
+    if (root.empty())
+    {
+        return false;
+    }
+
+    const std::string target = positionKey(pos);
+    for (const auto &child : generate_positions(root, isWhite(root)))
+    {
+        if (positionKey(child) == target)
+        {
+            return true;
+        }
+        for (const auto &grandchild : generate_positions(child, isWhite(child)))
+        {
+            if (positionKey(grandchild) == target)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Stores the root result in the transposition table and rebuilds the
+ *        principal variation (root, chosen move, expected reply) of the session.
+ *        The expected reply is the hash move of the chosen position.
+ *
+ * The root entry is the search's own best move and value (root_best, a bound of the root's
+ * value at root_depth), not the played move: the repetition filter may play another one.
+ * root_depth 0 stores nothing, for a search stopped before its first iteration finished.
+ */
+static void rememberSearch(SearchSession &session, const std::string &pos, const bestMoveInfo &chosen_move,
+                           const std::pair<float, std::string> &root_best, int root_depth, TTBound root_bound,
+                           bool isWhiteTurn)
+{
+    session.pv.clear();
+    session.pv.push_back(pos);
+
+    if (root_depth > 0)
+    {
+        session.transposition_table.store(hashFen(pos),
+                                          root_best.first,
+                                          moveMask(pos, root_best.second, isWhiteTurn),
+                                          root_depth,
+                                          root_bound);
+    }
+    session.pv.push_back(chosen_move.move);
+
+    TTEntry entry;
+    if (!session.transposition_table.probe(hashFen(chosen_move.move), entry) || entry.best_move == 0)
+    {
+        return;
+    }
+    for (const auto &reply : generate_positions(chosen_move.move, !isWhiteTurn))
+    {
+        if (moveMask(chosen_move.move, reply, !isWhiteTurn) == entry.best_move)
+        {
+            session.pv.push_back(reply);
+            std::cout << "Expected reply: " << reply << std::endl;
+            break;
+        }
+    }
+}
+
+
 bool isSafeMove(const std::string &candidate_pos, 
     const std::unordered_set<std::string> &previous_positions) {
 
@@ -132,16 +551,18 @@ return true;
  * @param model              Your chess engine model neural network
  * @param pos                Current position in FEN format
  * @param depth              Search depth
- * @param evaluations_map    Cache of evaluations keyed by Zobrist hash
+ * @param evaluations_map    Cache of network evaluations keyed by Zobrist hash, shared by the search threads
  * @param previous_positions A set of positions that have already occurred
+ * @param session            Transposition table and PV of the previous move, reused if pos follows it
  * @return                   The chosen best move
  */
 bestMoveInfo search_best_move(
     ChessNet &model,
     const std::string &pos,
     int depth,
-    std::unordered_map<uint64_t, float> &evaluations_map,
-    std::unordered_set<std::string> &previous_positions // note: pass by reference
+    EvalCache &evaluations_map,
+    std::unordered_set<std::string> &previous_positions, // note: pass by reference
+    SearchSession &session
 )
 {
 
@@ -155,15 +576,74 @@ bestMoveInfo search_best_move(
     std::cout << "Number of previous positions: " << previous_positions.size() << std::endl;
     std::cout << "Number evaluated positions: " << evaluations_map.size() << std::endl;
 
-    // 1. Check if there's a best move Chess Database
-    std::string response = getBestMoveFromCDB(pos);
-    std::cout << "response from database: " << response << std::endl;
-    if (response != "nobestmove")
+    // Keep the search state if this position follows the previous search (our move + reply)
+    if (session.pv.size() > 2 && positionKey(session.pv[2]) == positionKey(pos))
     {
-        chosen_move.move = response;
+        std::cout << "Expected reply was played, reusing previous search" << std::endl;
+    }
+    else if (isDescendant(session.root, pos))
+    {
+        std::cout << "Position follows the previous search, reusing previous search" << std::endl;
+    }
+    else
+    {
+        session.clear();
+    }
+    session.transposition_table.new_search();
+    evaluations_map.new_search();
+    if (session.prune_eval_cache && !session.control.pondering)
+    {
+        // After a capture or a pawn move some evaluations can never be needed again in this game.
+        // Not for a pondered guess: after a ponder miss the game goes on from a position the guess
+        // may have made look unreachable.
+        std::size_t evicted = evaluations_map.evict_unreachable(evalSignature(pos));
+        if (evicted > 0)
+        {
+            std::cout << "Evicted unreachable evaluations: " << evicted << std::endl;
+        }
+    }
+    session.root = pos;
+    MoveReceiver::transposition_table = &session.transposition_table;
+    MoveReceiver::control = &session.control;
+
+    // 1. Opening book (memory mapped, no network)
+    std::string book_move = session.use_book ? getBestMoveFromBook(pos) : "nobestmove";
+    if (book_move != "nobestmove")
+    {
+        std::cout << "Book move: " << book_move << std::endl;
+        chosen_move.move = book_move;
+        session.pv.clear(); // no expected reply to ponder on
         return chosen_move;
     }
 
+    // 1a. Syzygy tablebases: the DTZ move at the root, no search (and no deeper endgame search) needed
+    int tablebase_wdl = 0;
+    std::string tablebase_move = probeSyzygyRoot(pos, tablebase_wdl);
+    if (tablebase_move != "nobestmove")
+    {
+        std::cout << "Tablebase move: " << tablebase_move << " (wdl " << tablebase_wdl << ")" << std::endl;
+        chosen_move.move = tablebase_move;
+        chosen_move.eval = tablebase_wdl * (isWhite(pos) ? 1.0f : -1.0f);
+        session.pv.clear();
+        return chosen_move;
+    }
+
+    // 1b. Ask the Chess Cloud Database in the background (not while pondering, the position may never happen).
+    //     The local search runs meanwhile; a move arriving first stops it and is played instead.
+    if (session.use_cloud_database && !session.control.pondering &&
+        session.cloud_lookup.start(pos, [&session]() { session.control.stop = true; }))
+    {
+        // Answered from the on-disk cache, no need to search for a cached move
+        std::string response = session.cloud_lookup.finish();
+        std::cout << "cached response from database: " << response << std::endl;
+        if (response != "nobestmove")
+        {
+            chosen_move.move = response;
+            session.pv.clear();
+            return chosen_move;
+        }
+    }
+
     // 2. Possibly adjust search depth if the board is nearing endgame
     int goDeeperThreshold1 = 20;
     int goDeeperThreshold2 = 10;
@@ -194,65 +674,153 @@ bestMoveInfo search_best_move(
     if (next_positions.empty())
     {
         std::cout << "No moves available - returning dummy move.\n";
+        session.cloud_lookup.finish();
         chosen_move.move = "No moves available";
         return chosen_move;
     }
 
-    // 5. Evaluate each candidate position
-    std::vector<std::pair<float, std::string>> evaluations; 
-    evaluations.reserve(next_positions.size());
-
-    int sumOfNodes = 0;
-
+    // 5. Order the candidates with the values the transposition table kept from earlier searches,
+    //    unknown positions go last
+    std::vector<std::pair<float, std::string>> ordered;
+    ordered.reserve(next_positions.size());
     for (const auto &new_pos : next_positions)
     {
-        std::cout << "Evaluating position: " << new_pos << std::endl;
-
-        float eval = _PerfT(new_pos,
-                            depth - 1,
-                            std::numeric_limits<float>::lowest(),
-                            std::numeric_limits<float>::max(),
-                            model,
-                            evaluations_map);
+        TTEntry entry;
+        float guess = isWhiteTurn ? std::numeric_limits<float>::lowest() : std::numeric_limits<float>::max();
+        if (session.transposition_table.probe(hashFen(new_pos), entry))
+        {
+            guess = entry.value;
+        }
+        ordered.emplace_back(guess, new_pos);
+    }
+    auto bestFirst = [isWhiteTurn](const auto &a, const auto &b) {
+        return isWhiteTurn ? a.first > b.first : a.first < b.first;
+    };
+    std::stable_sort(ordered.begin(), ordered.end(), bestFirst);
+
+    // 6. Iterative deepening. If this position was already searched (e.g. as the expected reply)
+    //    start from the depth it was searched to, the shallower iterations are in the table.
+    //    Only a fully searched root counts, an early win stored just a bound.
+    int start_depth = 1;
+    TTEntry root_entry;
+    if (session.transposition_table.probe(hashFen(pos), root_entry) && root_entry.depth > 0 &&
+        root_entry.bound == TT_EXACT)
+    {
+        start_depth = std::min<int>(root_entry.depth, depth);
+    }
 
-        std::cout << "nodes: " << MoveReceiver::nodes << std::endl;
-        std::cout << "eval: " << eval << std::endl;
+    std::vector<std::pair<float, std::string>> evaluations;
+    evaluations.reserve(next_positions.size());
 
-        sumOfNodes += MoveReceiver::nodes;
+    int sumOfNodes = 0;
+    bool iteration_finished = true; // false if evaluations mixes partial results with table guesses
 
-        if(eval > 1 and isWhiteTurn and isSafeMove(new_pos, previous_positions))
+    for (int iteration_depth = start_depth; iteration_depth <= depth; iteration_depth++)
+    {
+        evaluations.clear();
+        for (const auto &candidate : ordered)
         {
-            std::cout << "Early return, found winning line for Whites" << std::endl;
-            previous_positions.insert(stripFen(new_pos));
-            std::cout << "Chosen Move: " << new_pos << std::endl;
+            const std::string &new_pos = candidate.second;
+            std::cout << "Evaluating position: " << new_pos << std::endl;
+            if (session.control.check_deadline())
+            {
+                break;
+            }
+
+            float eval = _PerfT(new_pos,
+                                iteration_depth - 1,
+                                std::numeric_limits<float>::lowest(),
+                                std::numeric_limits<float>::max(),
+                                model,
+                                evaluations_map);
+            if (session.control.stopped())
+            {
+                break;
+            }
+
+            std::cout << "nodes: " << MoveReceiver::nodes << std::endl;
             std::cout << "eval: " << eval << std::endl;
-            std::cout << "Positions (nodes) evaluated: " << sumOfNodes << std::endl;
-            chosen_move.move = new_pos;
-            chosen_move.nodes = sumOfNodes;
-            chosen_move.eval = eval;
-            return chosen_move;
+
+            sumOfNodes += MoveReceiver::nodes;
+
+            if(eval > 1 and isWhiteTurn and isSafeMove(new_pos, previous_positions))
+            {
+                std::cout << "Early return, found winning line for Whites" << std::endl;
+                previous_positions.insert(stripFen(new_pos));
+                std::cout << "Chosen Move: " << new_pos << std::endl;
+                std::cout << "eval: " << eval << std::endl;
+                std::cout << "Positions (nodes) evaluated: " << sumOfNodes << std::endl;
+                chosen_move.move = new_pos;
+                chosen_move.nodes = sumOfNodes;
+                chosen_move.eval = eval;
+                chosen_move.depth = iteration_depth;
+                session.cloud_lookup.finish(); // a forced win beats whatever the database says
+                // The other candidates were not searched: the root is worth at least this much
+                rememberSearch(session, pos, chosen_move, {eval, new_pos}, iteration_depth, TT_LOWER, isWhiteTurn);
+                return chosen_move;
+            }
+            else if (eval < -1 and !isWhiteTurn and isSafeMove(new_pos, previous_positions))
+            {
+                std::cout << "Early return, found winning line for Blacks" << std::endl;
+                previous_positions.insert(stripFen(new_pos));
+                std::cout << "Chosen Move: " << new_pos << std::endl;
+                std::cout << "eval: " << eval << std::endl;
+                std::cout << "Positions (nodes) evaluated: " << sumOfNodes << std::endl;
+                chosen_move.move = new_pos;
+                chosen_move.nodes = sumOfNodes;
+                chosen_move.eval = eval;
+                chosen_move.depth = iteration_depth;
+                session.cloud_lookup.finish(); // a forced win beats whatever the database says
+                // The other candidates were not searched: the root is worth at most this much
+                rememberSearch(session, pos, chosen_move, {eval, new_pos}, iteration_depth, TT_UPPER, isWhiteTurn);
+                return chosen_move;
+            }
+
+            // Collect the (eval, position) pair
+            evaluations.emplace_back(eval, new_pos);
         }
-        else if (eval < -1 and !isWhiteTurn and isSafeMove(new_pos, previous_positions))
+
+        if (session.control.stopped())
         {
-            std::cout << "Early return, found winning line for Blacks" << std::endl;
-            previous_positions.insert(stripFen(new_pos));
-            std::cout << "Chosen Move: " << new_pos << std::endl;
-            std::cout << "eval: " << eval << std::endl;
-            std::cout << "Positions (nodes) evaluated: " << sumOfNodes << std::endl;
-            chosen_move.move = new_pos;
-            chosen_move.nodes = sumOfNodes;
-            chosen_move.eval = eval;
-            return chosen_move;
+            std::cout << "Search stopped during depth " << iteration_depth << std::endl;
+            if (iteration_depth == start_depth)
+            {
+                // Nothing finished yet: the candidates searched so far, then the rest the table has a
+                // value for. Unknown ones only carry the ordering sentinel, which must not be played
+                // or reported as an evaluation.
+                const std::size_t searched = evaluations.size();
+                for (std::size_t i = searched; i < ordered.size(); i++)
+                {
+                    if (ordered[i].first != std::numeric_limits<float>::lowest() &&
+                        ordered[i].first != std::numeric_limits<float>::max())
+                    {
+                        evaluations.push_back(ordered[i]);
+                    }
+                }
+                if (evaluations.empty())
+                {
+                    evaluations.emplace_back(0.0f, ordered[searched].second); // Not even one move searched: neutral
+                }
+                iteration_finished = false;
+            }
+            else
+            {
+                // Throw away the unfinished iteration, the last finished one stands
+                evaluations = ordered;
+            }
+            chosen_move.depth = iteration_depth - 1;
+            break;
         }
-        
 
-        // Collect the (eval, position) pair
-        evaluations.emplace_back(eval, new_pos);
+        // The next iteration searches the best candidates of this one first
+        ordered = evaluations;
+        std::stable_sort(ordered.begin(), ordered.end(), bestFirst);
+        std::cout << "Depth " << iteration_depth << " done, nodes so far: " << sumOfNodes << std::endl;
     }
 
     chosen_move.nodes = sumOfNodes;
 
-    // 6. Sort the moves:
+    // 7. Sort the moves:
     //    - White to move => descending (higher eval is better)
     //    - Black to move => ascending (lower eval is better)
     if (isWhiteTurn)
@@ -270,11 +838,11 @@ bestMoveInfo search_best_move(
                   });
     }
 
-    // 7. Identify the best move overall (ignoring repetition).
+    // 8. Identify the best move overall (ignoring repetition).
     float best_eval_overall = evaluations[0].first;
     std::string best_move_overall = evaluations[0].second;
 
-    // 8. Gather "safe" moves (which won't cause or allow immediate repetition)
+    // 9. Gather "safe" moves (which won't cause or allow immediate repetition)
     std::vector<std::pair<float, std::string>> safe_moves;
     for (auto &ev : evaluations) {
         if (isSafeMove(ev.second, previous_positions)) {
@@ -303,7 +871,7 @@ bestMoveInfo search_best_move(
         chosen_move.eval = safe_moves[0].first;
         chosen_move.move = safe_moves[0].second;
 
-        // 9. If the best safe move is "losing" by your threshold,
+        // 10. If the best safe move is "losing" by your threshold,
         //    revert to the overall best move.
         //    (Assuming your evaluation is from White's perspective.)
         //
@@ -328,11 +896,24 @@ bestMoveInfo search_best_move(
         chosen_move.move = best_move_overall;
     }
 
+    // The database answer wins if it arrived before the local search was done
+    std::string cloud_move = session.cloud_lookup.finish();
+    std::cout << "response from database: " << cloud_move << std::endl;
+    if (cloud_move != "nobestmove")
+    {
+        chosen_move.move = cloud_move;
+        session.pv.clear(); // no expected reply to ponder on
+        return chosen_move;
+    }
+
     std::cout << "Chosen Move: " << chosen_move.move << std::endl;
     std::cout << "eval: " << chosen_move.eval << std::endl;
     std::cout << "Positions (nodes) evaluated: " << sumOfNodes << std::endl;
+    std::cout << "Syzygy probe hits so far: " << syzygyHits() << std::endl;
 
     previous_positions.insert(stripFen(chosen_move.move));
+    rememberSearch(session, pos, chosen_move, {best_eval_overall, best_move_overall},
+                   iteration_finished ? chosen_move.depth : 0, TT_EXACT, isWhiteTurn);
 
     return chosen_move;
 }
@@ -11,11 +11,210 @@
 #include <thread>  // Required for sleep_for
 #include <chrono>  // Required for time units
 #include <fstream>
+#include <atomic>
+#include <poll.h>
+#include <cstdlib>
 #include "../include/evaluate.h"
+#include "../include/polyglot_book.h"
+#include "../include/cdb_cache.h"
+#include "../include/tablebase.h"
+#include "../include/syzygy.h"
+#include "../include/shared_tables.h"
+#include "../include/eval_snapshot.h"
+#include "../../training/include/int8_inference.h"
 
 
 const int PORT = 12346;
 const int BUFFER_SIZE = 1024;
+const int SEARCH_DEPTH = 4;
+const bool PONDER = true;          // Search the expected reply while the opponent thinks
+const int DEFAULT_MOVETIME_MS = 0; // Time limit of a plain FEN request, 0 = search to SEARCH_DEPTH
+const char *BOOK_PATH = "../../data/book.bin";               // Polyglot book, override with MASALOT_BOOK
+const char *CDB_CACHE_PATH = "../../data/cdb_cache.bin";     // Cloud database answers, override with MASALOT_CDB_CACHE
+const char *TABLEBASE_PATH = "../../data/tablebases";        // Built by tablebase_generator, override with MASALOT_TABLEBASES
+const char *SYZYGY_PATH = "../../data/syzygy";               // Syzygy files (':' separated directories), override with MASALOT_SYZYGY
+const char *EVAL_SNAPSHOT_PATH = "../../data/eval_cache.bin"; // Evaluation cache kept between restarts, override with MASALOT_EVAL_SNAPSHOT
+const std::size_t SHARED_TABLES_MB = 1024;                   // Size of a new shared segment (MASALOT_SHM names it), override with MASALOT_SHM_MB
+const char *CPU_NET_PATH = "../../training/NN_weights/model_conv_folded.bin"; // Folded weights of the CPU forward pass, override with MASALOT_CPU_NET
+const char *INT8_NET_DIR = "../../training/NN_weights";                        // Int8 files named by model fingerprint (testing, training --qat), MASALOT_INT8_NET names one
+const char *FROZEN_MODEL_PATH = "../../training/NN_weights/model_frozen.pt";   // TorchScript copy for the libtorch path, override with MASALOT_FROZEN_MODEL
+
+// Search running on a worker thread, either for the current request or pondering on the expected reply.
+// The connection thread keeps reading the socket meanwhile, so "stop" and disconnects are noticed.
+struct BackgroundSearch
+{
+    std::thread worker;
+    std::atomic<bool> done{false};
+    bool pondering = false;
+    std::string fen;
+    std::unordered_set<std::string> previous_positions; // copy the search works on, taken over when it is used
+    std::string saved_root;                             // session state before pondering, restored on a miss
+    std::vector<std::string> saved_pv;
+    bestMoveInfo result;
+};
+
+/**
+ * @brief Starts search_best_move for fen on the worker thread.
+ *        The caller must not touch the model, evaluations_map or session until the worker is joined.
+ */
+void start_search(BackgroundSearch &search,
+                  ChessNet &model,
+                  const std::string &fen,
+                  EvalCache &evaluations_map,
+                  const std::unordered_set<std::string> &previous_positions,
+                  SearchSession &session)
+{
+    search.fen = fen;
+    search.previous_positions = previous_positions;
+    search.done = false;
+    search.worker = std::thread([&search, &model, &evaluations_map, &session]()
+                                {
+                                    search.result = search_best_move(model, search.fen, SEARCH_DEPTH, evaluations_map, search.previous_positions, session);
+                                    search.done = true; });
+}
+
+/**
+ * @brief Waits for the worker while watching the socket. "stop" ends the search early
+ *        (it still answers with the best move so far), any other message is kept in pending
+ *        and handled after the reply.
+ *
+ * @return false if the client disconnected, the search is stopped and thrown away then
+ */
+bool wait_for_search(BackgroundSearch &search,
+                     int client_socket,
+                     std::unordered_set<std::string> &previous_positions,
+                     SearchSession &session,
+                     std::string &pending)
+{
+    char buffer[BUFFER_SIZE];
+    bool connected = true;
+
+    while (!search.done)
+    {
+        // Check every millisecond. A second queued message stays in the socket until the reply is sent
+        pollfd fd{client_socket, POLLIN, 0};
+        int ready = pending.empty() ? poll(&fd, 1, 1) : poll(nullptr, 0, 1);
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        int bytes_read = read(client_socket, buffer, BUFFER_SIZE - 1);
+        if (bytes_read <= 0)
+        {
+            std::cout << "Client disconnected during the search, stopping it." << std::endl;
+            session.control.stop = true;
+            connected = false;
+            break;
+        }
+
+        std::string message(buffer, bytes_read);
+        if (message == "stop")
+        {
+            std::cout << "Received 'stop', returning the best move so far." << std::endl;
+            session.control.stop = true;
+        }
+        else
+        {
+            pending = message;
+        }
+    }
+
+    search.worker.join();
+    previous_positions = std::move(search.previous_positions);
+    return connected;
+}
+
+/**
+ * @brief Starts searching the expected reply (third position of the session PV) in the background.
+ */
+void start_pondering(BackgroundSearch &search,
+                     ChessNet &model,
+                     EvalCache &evaluations_map,
+                     const std::unordered_set<std::string> &previous_positions,
+                     SearchSession &session)
+{
+    if (!PONDER || session.pv.size() < 3)
+    {
+        return;
+    }
+
+    search.saved_root = session.root;
+    search.saved_pv = session.pv;
+    search.pondering = true;
+    session.control.reset();
+    session.control.pondering = true;
+
+    std::cout << "Pondering on: " << session.pv[2] << std::endl;
+    start_search(search, model, session.pv[2], evaluations_map, previous_positions, session);
+}
+
+/**
+ * @brief Resolves the running ponder search against the position the client sent.
+ *        On a hit the search continues as a normal one with the request's time limit and
+ *        has to be waited for with wait_for_search. On a miss (or any other message)
+ *        it is stopped and its result thrown away.
+ *
+ * @return true on a ponder hit
+ */
+bool finish_pondering(BackgroundSearch &search,
+                      const std::string &received_fen,
+                      int movetime_ms,
+                      SearchSession &session)
+{
+    if (!search.pondering)
+    {
+        return false;
+    }
+    search.pondering = false;
+
+    if (positionKey(received_fen) == positionKey(search.fen))
+    {
+        std::cout << "Ponder hit" << std::endl;
+        session.control.set_deadline_ms(movetime_ms);
+        session.control.pondering = false;
+        return true;
+    }
+
+    std::cout << "Ponder miss, stopping the background search" << std::endl;
+    session.control.stop = true;
+    search.worker.join();
+    session.control.reset();
+    // Entries stored by the stopped search stay valid, only the root and PV are restored
+    session.root = search.saved_root;
+    session.pv = search.saved_pv;
+    return false;
+}
+
+/**
+ * @brief Splits a request into the FEN and its time limit. Requests are either a plain FEN
+ *        or "movetime <ms> <FEN>".
+ */
+std::string parse_request(const std::string &message, int &movetime_ms)
+{
+    movetime_ms = DEFAULT_MOVETIME_MS;
+    const std::string prefix = "movetime ";
+    if (message.rfind(prefix, 0) != 0)
+    {
+        return message;
+    }
+
+    std::size_t end = message.find(' ', prefix.size());
+    if (end == std::string::npos)
+    {
+        return message;
+    }
+    try
+    {
+        movetime_ms = std::stoi(message.substr(prefix.size(), end - prefix.size()));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid movetime in request: " << message << std::endl;
+        movetime_ms = DEFAULT_MOVETIME_MS;
+    }
+    return message.substr(end + 1);
+}
 
 void handle_connection(int client_socket)
 {
@@ -28,8 +227,10 @@ void handle_connection(int client_socket)
               << "time\n";
 
     // Load the model
-    std::unordered_map<uint64_t, float> evaluations_map;
+    EvalCache evaluations_map;
     std::unordered_set<std::string> previous_positions;
+    SearchSession session; // Transposition table and PV kept between moves of the game
+    BackgroundSearch search;
     auto model = ChessNet();
     torch::serialize::InputArchive input_archive;
     try
@@ -55,13 +256,76 @@ void handle_connection(int client_socket)
         return;
     }
 
+    // An NNUE network updated along the search beats any full forward pass, but it replaces the
+    // model only on request (MASALOT_NNUE=../../training/NN_weights/nnue_halfkp.bin): training
+    // rewrites that file whenever a student improves and nothing checks it plays as well as the
+    // model. Otherwise a quantized copy of the weights reads a quarter of the memory per
+    // evaluation, and without a GPU the hand written float forward pass is still much faster
+    // than libtorch at batch size 1
+    const char *nnue_net_path = std::getenv("MASALOT_NNUE");
+    const char *int8_net_path = std::getenv("MASALOT_INT8_NET");
+    bool hand_written = (nnue_net_path != nullptr && enableNnueInference(nnue_net_path)) ||
+                        enableInt8Inference(model, int8_net_path ? int8_net_path : Int8Inference::filePath(INT8_NET_DIR, modelFingerprint(model)));
+    if (!hand_written && !torch::cuda::is_available())
+    {
+        const char *cpu_net_path = std::getenv("MASALOT_CPU_NET");
+        hand_written = enableCpuInference(model, cpu_net_path ? cpu_net_path : CPU_NET_PATH);
+    }
+
+    // libtorch evaluates the leaves otherwise, through the frozen copy of the folded model
+    if (!hand_written)
+    {
+        const char *frozen_model_path = std::getenv("MASALOT_FROZEN_MODEL");
+        enableFrozenModel(model, frozen_model_path ? frozen_model_path : FROZEN_MODEL_PATH);
+    }
+
+    // The cache holds outputs of the backend chosen above, only shared with and restored from the same one
+    const uint64_t cache_fingerprint = evalCacheFingerprint(model);
+    if (attachSharedTables(evaluations_map, session.transposition_table, cache_fingerprint))
+    {
+        // Other processes search other games in the same cache
+        session.prune_eval_cache = false;
+    }
+
+    // Warm start from the last snapshot of the same weights and backend, new snapshots while the game goes on
+    const char *snapshot_path = std::getenv("MASALOT_EVAL_SNAPSHOT");
+    EvalCacheSnapshots snapshots(evaluations_map, snapshot_path ? snapshot_path : EVAL_SNAPSHOT_PATH, cache_fingerprint);
+    snapshots.load();
+
     // Loop to handle multiple FEN strings in the same connection
+    std::string pending; // message that arrived while a search was running
     while (true)
     {
-        memset(buffer, 0, BUFFER_SIZE);
+        std::string message;
+        int bytes_read = 1;
+        if (!pending.empty())
+        {
+            message.swap(pending);
+        }
+        else
+        {
+            memset(buffer, 0, BUFFER_SIZE);
+
+            // Read the incoming FEN string from the client.
+            bytes_read = read(client_socket, buffer, BUFFER_SIZE - 1);
+            if (bytes_read > 0)
+            {
+                message.assign(buffer, bytes_read);
+            }
+        }
+
+        int movetime_ms;
+        std::string received_fen = parse_request(message, movetime_ms);
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        // Whatever arrived, the ponder search has to be resolved before anything else touches the session
+        bool ponder_hit = finish_pondering(search, received_fen, movetime_ms, session);
+        if (ponder_hit && !wait_for_search(search, client_socket, previous_positions, session, pending))
+        {
+            close(client_socket);
+            return;
+        }
 
-        // Read the incoming FEN string from the client.
-        int bytes_read = read(client_socket, buffer, BUFFER_SIZE - 1);
         if (bytes_read < 0)
         {
             std::cerr << "Failed to read from socket" << std::endl;
@@ -76,8 +340,6 @@ void handle_connection(int client_socket)
             return;
         }
 
-        std::string received_fen(buffer, bytes_read); // Construct string from buffer
-
         // Check if the received message is "end".
         if (received_fen == "end")
         {
@@ -86,12 +348,20 @@ void handle_connection(int client_socket)
             break;
         }
 
+        // "stop" only means something while a search runs, it is handled in wait_for_search
+        if (received_fen == "stop")
+        {
+            std::cout << "Received 'stop' with no search running, ignoring." << std::endl;
+            continue;
+        }
+
         std::cout << "Received FEN: " << received_fen << std::endl;
 
         if (received_fen == "clear")
         {
             previous_positions.clear();
             evaluations_map.clear();
+            session.clear();
             std::this_thread::sleep_for(std::chrono::seconds(1));
             std::cout << "Removed previous positions and evaluations" << std::endl;
             std::string resp = "cleared";
@@ -104,10 +374,19 @@ void handle_connection(int client_socket)
         }
         else
         {
-
-            // Get the best move FEN from the model
-            auto start_time = std::chrono::high_resolution_clock::now();
-            bestMoveInfo moveInfo = search_best_move(model, received_fen, 4, evaluations_map, previous_positions); // Depth set to 2 for example
+            // Get the best move FEN from the model, unless pondering already found it
+            if (!ponder_hit)
+            {
+                session.control.reset();
+                session.control.set_deadline_ms(movetime_ms);
+                start_search(search, model, received_fen, evaluations_map, previous_positions, session);
+                if (!wait_for_search(search, client_socket, previous_positions, session, pending))
+                {
+                    close(client_socket);
+                    return;
+                }
+            }
+            bestMoveInfo moveInfo = search.result;
             auto end_time = std::chrono::high_resolution_clock::now();
             std::chrono::duration<float> duration = end_time - start_time;
             std::cout << "Time taken to find best move: " << duration.count() << " seconds." << std::endl;
@@ -125,6 +404,9 @@ void handle_connection(int client_socket)
                 close(client_socket); // Handle error and close connection
                 return;
             }
+
+            snapshots.saveInBackground();
+            start_pondering(search, model, evaluations_map, previous_positions, session);
         }
         // Loop back to read the next move from the client
         std::cout << "Waiting for the next move..." << std::endl;
@@ -138,6 +420,49 @@ int main()
     struct sockaddr_in address;
     int addrlen = sizeof(address);
 
+    // Opening book is optional, without it the engine goes straight to the cloud database / search
+    const char *book_path = std::getenv("MASALOT_BOOK");
+    if (!openBook(book_path ? book_path : BOOK_PATH))
+    {
+        std::cout << "Running without an opening book" << std::endl;
+    }
+
+    // Cloud database answers kept between games and restarts
+    const char *cache_path = std::getenv("MASALOT_CDB_CACHE");
+    if (!openCloudDatabaseCache(cache_path ? cache_path : CDB_CACHE_PATH))
+    {
+        std::cout << "Running without a cloud database cache" << std::endl;
+    }
+
+    // Endgame tables, probed by the search instead of the network when at most 4 pieces are left
+    const char *tablebase_path = std::getenv("MASALOT_TABLEBASES");
+    if (!openTablebases(tablebase_path ? tablebase_path : TABLEBASE_PATH))
+    {
+        std::cout << "Running without tablebases" << std::endl;
+    }
+
+    // Syzygy tables, MASALOT_SYZYGY_PROBE_LIMIT keeps the search from probing the largest ones
+    const char *syzygy_path = std::getenv("MASALOT_SYZYGY");
+    if (openSyzygy(syzygy_path ? syzygy_path : SYZYGY_PATH))
+    {
+        const char *probe_limit = std::getenv("MASALOT_SYZYGY_PROBE_LIMIT");
+        if (probe_limit)
+        {
+            setSyzygyProbeLimit(std::atoi(probe_limit));
+        }
+    }
+
+    // Evaluation cache and transposition table shared by every engine process on the host
+    const char *shm_name = std::getenv("MASALOT_SHM");
+    if (shm_name)
+    {
+        const char *shm_mb = std::getenv("MASALOT_SHM_MB");
+        if (!openSharedTables(shm_name, shm_mb ? std::strtoull(shm_mb, nullptr, 10) : SHARED_TABLES_MB))
+        {
+            std::cout << "Running with per process tables" << std::endl;
+        }
+    }
+
     // Creating socket file descriptor
     if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0)
     {
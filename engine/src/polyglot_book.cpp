@@ -0,0 +1,322 @@
+#include "../include/polyglot_book.h"
+#include "../include/polyglot_keys.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Board of a FEN as 64 chars, index = 8 * row + file with row 0 = rank 1 and file 0 = a (Polyglot square numbering)
+static void parseBoard(const std::string &placement, char board[64])
+{
+    std::fill(board, board + 64, ' ');
+    int row = 7;
+    int file = 0;
+    for (char c : placement)
+    {
+        if (c == '/')
+        {
+            row--;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8')
+        {
+            file += c - '0';
+        }
+        else if (row >= 0 && file < 8)
+        {
+            board[8 * row + file] = c;
+            file++;
+        }
+    }
+}
+
+// Polyglot piece kind: black pawn 0, white pawn 1, black knight 2, ... white king 11
+static int pieceKind(char piece)
+{
+    static const std::string order = "pnbrqk";
+    std::size_t type = order.find(static_cast<char>(std::tolower(static_cast<unsigned char>(piece))));
+    if (type == std::string::npos)
+    {
+        return -1;
+    }
+    return 2 * static_cast<int>(type) + (std::isupper(static_cast<unsigned char>(piece)) ? 1 : 0);
+}
+
+uint64_t polyglotKey(const std::string &fen)
+{
+    std::istringstream fenStream(fen);
+    std::string placement, turn, castling, enPassant;
+    fenStream >> placement >> turn >> castling >> enPassant;
+
+    char board[64];
+    parseBoard(placement, board);
+
+    uint64_t key = 0;
+
+    // 1) Pieces
+    for (int sq = 0; sq < 64; sq++)
+    {
+        int kind = pieceKind(board[sq]);
+        if (kind >= 0)
+        {
+            key ^= PolyglotKeys::RANDOM[64 * kind + sq];
+        }
+    }
+
+    // 2) Castling rights
+    for (char c : castling)
+    {
+        switch (c)
+        {
+            case 'K': key ^= PolyglotKeys::RANDOM[PolyglotKeys::CASTLE + 0]; break;
+            case 'Q': key ^= PolyglotKeys::RANDOM[PolyglotKeys::CASTLE + 1]; break;
+            case 'k': key ^= PolyglotKeys::RANDOM[PolyglotKeys::CASTLE + 2]; break;
+            case 'q': key ^= PolyglotKeys::RANDOM[PolyglotKeys::CASTLE + 3]; break;
+            default: break;
+        }
+    }
+
+    // 3) En passant, only if a pawn of the side to move can actually take
+    bool white = (turn == "w");
+    if (enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h')
+    {
+        int file = enPassant[0] - 'a';
+        int row = white ? 4 : 3;
+        char pawn = white ? 'P' : 'p';
+        bool canTake = (file > 0 && board[8 * row + file - 1] == pawn) ||
+                       (file < 7 && board[8 * row + file + 1] == pawn);
+        if (canTake)
+        {
+            key ^= PolyglotKeys::RANDOM[PolyglotKeys::EN_PASSANT + file];
+        }
+    }
+
+    // 4) Side to move
+    if (white)
+    {
+        key ^= PolyglotKeys::RANDOM[PolyglotKeys::TURN];
+    }
+
+    return key;
+}
+
+// --------------------------------------------------
+// Move encoding: to file (bits 0-2), to row (3-5), from file (6-8), from row (9-11), promotion (12-14)
+// --------------------------------------------------
+static std::string squareName(int sq)
+{
+    return std::string{static_cast<char>('a' + sq % 8), static_cast<char>('1' + sq / 8)};
+}
+
+std::string PolyglotBook::moveToUci(uint16_t move, const std::string &fen)
+{
+    int to = move & 0x3f;
+    int from = (move >> 6) & 0x3f;
+    int promotion = (move >> 12) & 0x7;
+
+    // Castling is stored as king takes own rook: e1h1, e1a1, e8h8, e8a8
+    char board[64];
+    parseBoard(fen.substr(0, fen.find(' ')), board);
+    if (board[from] == 'K' || board[from] == 'k')
+    {
+        if (from == 4 && to == 7) to = 6;
+        else if (from == 4 && to == 0) to = 2;
+        else if (from == 60 && to == 63) to = 62;
+        else if (from == 60 && to == 56) to = 58;
+    }
+
+    std::string uci = squareName(from) + squareName(to);
+    if (promotion > 0 && promotion <= 4)
+    {
+        uci += " nbrq"[promotion];
+    }
+    return uci;
+}
+
+uint16_t polyglotMove(const std::string &uci, const std::string &fen)
+{
+    int from = (uci[0] - 'a') + 8 * (uci[1] - '1');
+    int to = (uci[2] - 'a') + 8 * (uci[3] - '1');
+    int promotion = 0;
+    if (uci.size() > 4)
+    {
+        promotion = static_cast<int>(std::string(" nbrq").find(uci[4]));
+    }
+
+    char board[64];
+    parseBoard(fen.substr(0, fen.find(' ')), board);
+    if (board[from] == 'K' || board[from] == 'k')
+    {
+        if (from == 4 && to == 6) to = 7;
+        else if (from == 4 && to == 2) to = 0;
+        else if (from == 60 && to == 62) to = 63;
+        else if (from == 60 && to == 58) to = 56;
+    }
+
+    return static_cast<uint16_t>(to | (from << 6) | (promotion << 12));
+}
+
+// --------------------------------------------------
+// Book file
+// --------------------------------------------------
+static uint64_t readBigEndian(const unsigned char *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static PolyglotEntry readEntry(const unsigned char *p)
+{
+    PolyglotEntry entry;
+    entry.key = readBigEndian(p, 8);
+    entry.move = static_cast<uint16_t>(readBigEndian(p + 8, 2));
+    entry.weight = static_cast<uint16_t>(readBigEndian(p + 10, 2));
+    entry.learn = static_cast<uint32_t>(readBigEndian(p + 12, 4));
+    return entry;
+}
+
+PolyglotBook::~PolyglotBook()
+{
+    close();
+}
+
+bool PolyglotBook::open(const std::string &book_path)
+{
+    close();
+    int fd = ::open(book_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Opening book not found: " << book_path << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 16)
+    {
+        std::cerr << "Opening book is empty: " << book_path << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Error: failed to mmap opening book " << book_path << std::endl;
+        return false;
+    }
+
+    entries = static_cast<const unsigned char *>(mapping);
+    mapped_bytes = st.st_size;
+    count = st.st_size / 16;
+    std::cout << "Opening book loaded: " << book_path << " (" << count << " entries)" << std::endl;
+    return true;
+}
+
+void PolyglotBook::close()
+{
+    if (entries != nullptr)
+    {
+        munmap(const_cast<unsigned char *>(entries), mapped_bytes);
+    }
+    entries = nullptr;
+    count = 0;
+    mapped_bytes = 0;
+}
+
+std::vector<PolyglotEntry> PolyglotBook::probe(uint64_t key) const
+{
+    std::vector<PolyglotEntry> moves;
+    if (entries == nullptr)
+    {
+        return moves;
+    }
+
+    // Lower bound of the key, entries are sorted by key
+    std::size_t low = 0;
+    std::size_t high = count;
+    while (low < high)
+    {
+        std::size_t mid = low + (high - low) / 2;
+        if (readBigEndian(entries + 16 * mid, 8) < key)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    for (std::size_t i = low; i < count; i++)
+    {
+        PolyglotEntry entry = readEntry(entries + 16 * i);
+        if (entry.key != key)
+        {
+            break;
+        }
+        moves.push_back(entry);
+    }
+    return moves;
+}
+
+std::string PolyglotBook::pickMove(const std::string &fen) const
+{
+    std::vector<PolyglotEntry> moves = probe(polyglotKey(fen));
+    if (moves.empty())
+    {
+        return "nobestmove";
+    }
+
+    // Probability proportional to the weight, uniform if all weights are 0
+    uint64_t total = 0;
+    for (const auto &entry : moves)
+    {
+        total += entry.weight;
+    }
+
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    std::size_t chosen = 0;
+    if (total == 0)
+    {
+        chosen = std::uniform_int_distribution<std::size_t>(0, moves.size() - 1)(rng);
+    }
+    else
+    {
+        uint64_t r = std::uniform_int_distribution<uint64_t>(0, total - 1)(rng);
+        while (r >= moves[chosen].weight)
+        {
+            r -= moves[chosen].weight;
+            chosen++;
+        }
+    }
+    return moveToUci(moves[chosen].move, fen);
+}
+
+// --------------------------------------------------
+// Process wide book
+// --------------------------------------------------
+static PolyglotBook book;
+
+bool openBook(const std::string &book_path)
+{
+    return book.open(book_path);
+}
+
+std::string getBestMoveFromBook(const std::string &fen)
+{
+    if (!book.isOpen())
+    {
+        return "nobestmove";
+    }
+    return book.pickMove(fen);
+}
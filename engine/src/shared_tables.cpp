@@ -0,0 +1,200 @@
+#include "../include/shared_tables.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared tables need lock free 64 bit atomics");
+
+// --------------------------------------------------
+// Segment layout: 64 byte aligned header, evaluation cache entries, transposition table slots
+// --------------------------------------------------
+static const char SEGMENT_MAGIC[8] = {'M', 'S', 'L', 'S', 'H', 'M', '0', '2'};
+static constexpr std::size_t HEADER_BYTES = 128;
+
+struct alignas(64) SharedTables::Header
+{
+    char magic[8];
+    std::uint64_t eval_entries;
+    std::uint64_t tt_entries;
+    std::uint64_t total_bytes;
+    std::atomic<std::uint32_t> ready; // set by the creator once the header is written
+    std::atomic<std::uint64_t> fingerprint; // weights and backend of the first process attached, 0 before
+    EvalCache::State eval_state;
+};
+
+static std::size_t floorPowerOfTwo(std::size_t n)
+{
+    std::size_t size = 1;
+    while ((size << 1) <= n)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+SharedTables::~SharedTables()
+{
+    close();
+}
+
+bool SharedTables::open(const std::string &name, std::size_t megabytes)
+{
+    static_assert(sizeof(Header) <= HEADER_BYTES, "header does not fit");
+    close();
+
+    // Exclusive create tells the first process apart, it sizes and initializes the segment
+    bool creator = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST)
+    {
+        creator = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        std::cerr << "Cannot open shared memory segment " << name << std::endl;
+        return false;
+    }
+
+    std::size_t bytes = 0;
+    if (creator)
+    {
+        const std::size_t half = megabytes * 1024 * 1024 / 2;
+        const std::size_t eval_entries = floorPowerOfTwo(std::max<std::size_t>(half / sizeof(std::uint64_t), 4));
+        const std::size_t tt_entries = floorPowerOfTwo(std::max<std::size_t>(half / sizeof(TTSlot), 1));
+        bytes = HEADER_BYTES + eval_entries * sizeof(std::uint64_t) + tt_entries * sizeof(TTSlot);
+        if (ftruncate(fd, bytes) != 0)
+        {
+            std::cerr << "Error: cannot size shared memory segment " << name << std::endl;
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Error: failed to mmap shared memory segment " << name << std::endl;
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // ftruncate zero fills: every entry and slot starts empty
+        mapping = static_cast<unsigned char *>(map);
+        header = new (mapping) Header{};
+        std::memcpy(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+        header->eval_entries = eval_entries;
+        header->tt_entries = tt_entries;
+        header->total_bytes = bytes;
+        header->ready.store(1, std::memory_order_release);
+    }
+    else
+    {
+        // Wait for the creator to size the segment and write the header
+        struct stat st;
+        Header *peek = nullptr;
+        for (int attempt = 0; attempt < 500; attempt++)
+        {
+            if (peek == nullptr && fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= HEADER_BYTES)
+            {
+                void *map = mmap(nullptr, HEADER_BYTES, PROT_READ, MAP_SHARED, fd, 0);
+                peek = map == MAP_FAILED ? nullptr : static_cast<Header *>(map);
+            }
+            if (peek != nullptr && peek->ready.load(std::memory_order_acquire) == 1)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        const bool valid = peek != nullptr && peek->ready.load(std::memory_order_acquire) == 1 &&
+                           std::memcmp(peek->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0 &&
+                           fstat(fd, &st) == 0 && static_cast<std::uint64_t>(st.st_size) == peek->total_bytes;
+        if (valid)
+        {
+            bytes = peek->total_bytes;
+        }
+        if (peek != nullptr)
+        {
+            munmap(peek, HEADER_BYTES);
+        }
+        if (!valid)
+        {
+            std::cerr << "Error: shared memory segment " << name << " is not a Masalot segment" << std::endl;
+            ::close(fd);
+            return false;
+        }
+
+        void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Error: failed to mmap shared memory segment " << name << std::endl;
+            return false;
+        }
+        mapping = static_cast<unsigned char *>(map);
+        header = reinterpret_cast<Header *>(mapping);
+    }
+
+    mapped_bytes = bytes;
+    std::cout << "Shared tables: " << name << (creator ? " (new), " : ", ") << header->eval_entries
+              << " evaluations, " << header->tt_entries << " transpositions" << std::endl;
+    return true;
+}
+
+void SharedTables::close()
+{
+    // The segment itself stays for the other processes (and the next start)
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mapped_bytes);
+    }
+    mapping = nullptr;
+    mapped_bytes = 0;
+    header = nullptr;
+}
+
+bool SharedTables::attach(EvalCache &cache, TranspositionTable &table, std::uint64_t fingerprint)
+{
+    // The first process claims the segment, evaluations of other weights or backends stay out
+    std::uint64_t owner = 0;
+    if (!header->fingerprint.compare_exchange_strong(owner, fingerprint) && owner != fingerprint)
+    {
+        std::cerr << "Shared tables hold evaluations of another network or backend, not attaching" << std::endl;
+        return false;
+    }
+
+    auto *eval_entries = reinterpret_cast<std::atomic<std::uint64_t> *>(mapping + HEADER_BYTES);
+    auto *tt_slots = reinterpret_cast<TTSlot *>(mapping + HEADER_BYTES + header->eval_entries * sizeof(std::uint64_t));
+    cache.attach(eval_entries, header->eval_entries, &header->eval_state);
+    table.attach(tt_slots, header->tt_entries);
+    return true;
+}
+
+// --------------------------------------------------
+// Process wide segment
+// --------------------------------------------------
+static SharedTables sharedTables;
+
+bool openSharedTables(const std::string &name, std::size_t megabytes)
+{
+    return sharedTables.open(name, megabytes);
+}
+
+bool attachSharedTables(EvalCache &cache, TranspositionTable &table, std::uint64_t fingerprint)
+{
+    if (!sharedTables.isOpen())
+    {
+        return false;
+    }
+    return sharedTables.attach(cache, table, fingerprint);
+}
@@ -0,0 +1,172 @@
+#include "../include/syzygy.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#ifdef USE_SYZYGY
+#include "tbprobe.h"
+#endif
+
+static std::atomic<uint64_t> hits{0};
+static int probe_limit = 0;
+
+uint64_t syzygyHits()
+{
+    return hits.load(std::memory_order_relaxed);
+}
+
+int syzygyProbeLimit()
+{
+    return probe_limit;
+}
+
+#ifdef USE_SYZYGY
+
+// Fathom counts the files from a, Gigantua from h: mirror every rank
+static uint64_t mirrorFiles(uint64_t bits)
+{
+    bits = ((bits >> 1) & 0x5555555555555555ull) | ((bits & 0x5555555555555555ull) << 1);
+    bits = ((bits >> 2) & 0x3333333333333333ull) | ((bits & 0x3333333333333333ull) << 2);
+    bits = ((bits >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((bits & 0x0F0F0F0F0F0F0F0Full) << 4);
+    return bits;
+}
+
+static int toWdl(unsigned result)
+{
+    switch (result)
+    {
+        case TB_WIN: return 1;
+        case TB_LOSS: return -1;
+        default: return 0; // draws, and the 50 move rule spoils cursed wins and blessed losses
+    }
+}
+
+bool openSyzygy(const std::string &paths)
+{
+    if (!tb_init(paths.c_str()) || TB_LARGEST == 0)
+    {
+        std::cerr << "No Syzygy tablebases found in " << paths << std::endl;
+        return false;
+    }
+    probe_limit = static_cast<int>(TB_LARGEST);
+    std::cout << "Syzygy tablebases loaded: up to " << TB_LARGEST << " pieces from " << paths << std::endl;
+    return true;
+}
+
+void setSyzygyProbeLimit(int pieces)
+{
+    probe_limit = std::min(pieces, static_cast<int>(TB_LARGEST));
+}
+
+bool probeSyzygyWdl(const uint64_t pieces[12], bool white_to_move, int &wdl)
+{
+    uint64_t board[12];
+    for (int i = 0; i < 12; i++)
+    {
+        board[i] = mirrorFiles(pieces[i]);
+    }
+    const uint64_t black = board[0] | board[1] | board[2] | board[3] | board[4] | board[5];
+    const uint64_t white = board[6] | board[7] | board[8] | board[9] | board[10] | board[11];
+
+    unsigned result = tb_probe_wdl(white, black,
+                                   board[5] | board[11], board[4] | board[10], board[3] | board[9],
+                                   board[2] | board[8], board[1] | board[7], board[0] | board[6],
+                                   0, 0, 0, white_to_move);
+    if (result == TB_RESULT_FAILED)
+    {
+        return false;
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    wdl = toWdl(result);
+    return true;
+}
+
+std::string probeSyzygyRoot(const std::string &fen, int &wdl)
+{
+    std::istringstream fenStream(fen);
+    std::string placement, turn, castling, enPassant;
+    unsigned halfmove = 0;
+    fenStream >> placement >> turn >> castling >> enPassant >> halfmove;
+    if (probe_limit == 0 || castling != "-")
+    {
+        return "nobestmove";
+    }
+
+    // Standard square numbering, a1 = 0
+    uint64_t white = 0, black = 0, kings = 0, queens = 0, rooks = 0, bishops = 0, knights = 0, pawns = 0;
+    int row = 7, file = 0, count = 0;
+    for (char c : placement)
+    {
+        if (c == '/') { row--; file = 0; continue; }
+        if (c >= '1' && c <= '8') { file += c - '0'; continue; }
+        const uint64_t bit = 1ull << (8 * row + file++);
+        count++;
+        (std::isupper(static_cast<unsigned char>(c)) ? white : black) |= bit;
+        switch (std::tolower(static_cast<unsigned char>(c)))
+        {
+            case 'k': kings |= bit; break;
+            case 'q': queens |= bit; break;
+            case 'r': rooks |= bit; break;
+            case 'b': bishops |= bit; break;
+            case 'n': knights |= bit; break;
+            default: pawns |= bit; break;
+        }
+    }
+    if (count > probe_limit)
+    {
+        return "nobestmove";
+    }
+    const unsigned ep = enPassant.size() == 2 ? (enPassant[1] - '1') * 8 + (enPassant[0] - 'a') : 0;
+
+    // tb_probe_root is not thread safe (unlike tb_probe_wdl), book_builder searches on several threads
+    static std::mutex root_probe;
+    unsigned result;
+    {
+        std::lock_guard<std::mutex> lock(root_probe);
+        result = tb_probe_root(white, black, kings, queens, rooks, bishops, knights, pawns,
+                               halfmove, 0, ep, turn == "w", nullptr);
+    }
+    if (result == TB_RESULT_FAILED || result == TB_RESULT_CHECKMATE || result == TB_RESULT_STALEMATE)
+    {
+        return "nobestmove";
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    wdl = toWdl(TB_GET_WDL(result));
+
+    auto square = [](unsigned sq) { return std::string{static_cast<char>('a' + sq % 8), static_cast<char>('1' + sq / 8)}; };
+    std::string uci = square(TB_GET_FROM(result)) + square(TB_GET_TO(result));
+    switch (TB_GET_PROMOTES(result))
+    {
+        case TB_PROMOTES_QUEEN: uci += 'q'; break;
+        case TB_PROMOTES_ROOK: uci += 'r'; break;
+        case TB_PROMOTES_BISHOP: uci += 'b'; break;
+        case TB_PROMOTES_KNIGHT: uci += 'n'; break;
+        default: break;
+    }
+    return uci;
+}
+
+#else
+
+bool openSyzygy(const std::string &paths)
+{
+    std::cout << "Built without Syzygy support (set FATHOM_DIR), ignoring " << paths << std::endl;
+    return false;
+}
+
+void setSyzygyProbeLimit(int) {}
+
+bool probeSyzygyWdl(const uint64_t *, bool, int &)
+{
+    return false;
+}
+
+std::string probeSyzygyRoot(const std::string &, int &)
+{
+    return "nobestmove";
+}
+
+#endif // USE_SYZYGY
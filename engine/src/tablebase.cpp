@@ -0,0 +1,398 @@
+#include "../include/tablebase.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char TABLE_MAGIC[8] = {'M', 'S', 'L', 'T', 'B', '0', '0', '1'};
+static constexpr std::size_t TABLE_HEADER_BYTES = 16;
+
+static const char PIECE_LETTERS[] = " PNBRQK";
+
+// --------------------------------------------------
+// Normalization
+// --------------------------------------------------
+
+// White before black, king first, then queen, rook, bishop, knight, pawn
+static int orderKey(uint8_t piece)
+{
+    int type = piece & 7;
+    return (piece & TB_BLACK ? 16 : 0) + (type == TB_KING ? 0 : 8 - type);
+}
+
+static void sortPieces(TBPosition &pos)
+{
+    for (int i = 1; i < pos.count; i++)
+    {
+        for (int j = i; j > 0 && orderKey(pos.piece[j]) < orderKey(pos.piece[j - 1]); j--)
+        {
+            std::swap(pos.piece[j], pos.piece[j - 1]);
+            std::swap(pos.square[j], pos.square[j - 1]);
+        }
+    }
+}
+
+// Side strength for choosing which side is white in the table: more pieces, then the stronger ones
+static uint32_t sideStrength(const TBPosition &pos, bool black)
+{
+    uint32_t strength = 0;
+    int pieces = 0;
+    for (int i = 0; i < pos.count; i++)
+    {
+        if (((pos.piece[i] & TB_BLACK) != 0) == black && (pos.piece[i] & 7) != TB_KING)
+        {
+            strength = strength * 8 + (pos.piece[i] & 7); // sorted already, strongest first
+            pieces++;
+        }
+    }
+    for (int i = pieces; i < TB_MAX_PIECES; i++)
+    {
+        strength *= 8;
+    }
+    return (pieces << 16) | strength;
+}
+
+uint32_t normalizePosition(TBPosition &pos)
+{
+    sortPieces(pos);
+    if (sideStrength(pos, true) > sideStrength(pos, false))
+    {
+        // Black is stronger: swap the colours and mirror the ranks
+        for (int i = 0; i < pos.count; i++)
+        {
+            pos.piece[i] ^= TB_BLACK;
+            pos.square[i] ^= 56;
+        }
+        pos.white_to_move = !pos.white_to_move;
+        sortPieces(pos);
+    }
+
+    uint32_t material = 0;
+    for (int i = 0; i < pos.count; i++)
+    {
+        material |= static_cast<uint32_t>(pos.piece[i]) << (8 * i);
+    }
+    return material;
+}
+
+std::string tableName(uint32_t material)
+{
+    std::string name;
+    for (int i = 0; i < TB_MAX_PIECES && (material >> (8 * i)) != 0; i++)
+    {
+        const uint8_t piece = static_cast<uint8_t>(material >> (8 * i));
+        if (piece == (TB_KING | TB_BLACK))
+        {
+            name += 'v';
+        }
+        name += PIECE_LETTERS[piece & 7];
+    }
+    return name;
+}
+
+uint32_t tableMaterial(const std::string &name)
+{
+    TBPosition pos;
+    uint8_t colour = 0;
+    for (char c : name)
+    {
+        const char *letter = std::strchr(PIECE_LETTERS + 1, c);
+        if (c == 'v')
+        {
+            colour = TB_BLACK;
+        }
+        else if (letter == nullptr || pos.count == TB_MAX_PIECES)
+        {
+            return 0;
+        }
+        else
+        {
+            pos.add(static_cast<uint8_t>((letter - PIECE_LETTERS) | colour), pos.count);
+        }
+    }
+    return normalizePosition(pos);
+}
+
+static int pieceCount(uint32_t material)
+{
+    int count = 0;
+    while (count < TB_MAX_PIECES && (material >> (8 * count)) != 0)
+    {
+        count++;
+    }
+    return count;
+}
+
+static bool hasPawns(uint32_t material)
+{
+    for (int i = 0; i < TB_MAX_PIECES; i++)
+    {
+        if (((material >> (8 * i)) & 7) == TB_PAWN)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// --------------------------------------------------
+// Indexing: white king square with the symmetries folded away, 64 squares for every other piece,
+// side to move in the lowest bit. Without pawns the white king is brought into the a1-d1-d4
+// triangle (10 squares), with pawns only the files are mirrored (32 squares).
+// --------------------------------------------------
+static const int TRIANGLE_SQUARES[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+static const int TRIANGLE_INDEX[32] = {0, 1, 2, 3, -1, -1, -1, -1,
+                                       -1, 4, 5, 6, -1, -1, -1, -1,
+                                       -1, -1, 7, 8, -1, -1, -1, -1,
+                                       -1, -1, -1, 9, -1, -1, -1, -1};
+
+uint64_t tableEntries(uint32_t material)
+{
+    uint64_t entries = hasPawns(material) ? 32 : 10;
+    for (int i = 1; i < pieceCount(material); i++)
+    {
+        entries *= 64;
+    }
+    return entries * 2;
+}
+
+uint64_t positionIndex(uint32_t material, const TBPosition &pos)
+{
+    const bool pawns = hasPawns(material);
+    int king = pos.square[0];
+    const bool flipFile = (king & 7) > 3;
+    if (flipFile) king ^= 7;
+    const bool flipRank = !pawns && (king >> 3) > 3;
+    if (flipRank) king ^= 56;
+    const bool transpose = !pawns && (king >> 3) > (king & 7);
+    if (transpose) king = ((king & 7) << 3) | (king >> 3);
+
+    auto transform = [&](int sq)
+    {
+        if (flipFile) sq ^= 7;
+        if (flipRank) sq ^= 56;
+        if (transpose) sq = ((sq & 7) << 3) | (sq >> 3);
+        return sq;
+    };
+
+    uint64_t index = pawns ? (king >> 3) * 4 + (king & 7) : TRIANGLE_INDEX[king];
+    for (int i = 1; i < pos.count; i++)
+    {
+        index = index * 64 + transform(pos.square[i]);
+    }
+    return index * 2 + (pos.white_to_move ? 0 : 1);
+}
+
+void decodeIndex(uint32_t material, uint64_t index, TBPosition &pos)
+{
+    pos.count = pieceCount(material);
+    pos.white_to_move = (index & 1) == 0;
+    index >>= 1;
+    for (int i = pos.count - 1; i >= 0; i--)
+    {
+        pos.piece[i] = static_cast<uint8_t>(material >> (8 * i));
+        if (i > 0)
+        {
+            pos.square[i] = static_cast<uint8_t>(index % 64);
+            index /= 64;
+        }
+    }
+    pos.square[0] = static_cast<uint8_t>(hasPawns(material) ? (index / 4) * 8 + index % 4 : TRIANGLE_SQUARES[index]);
+}
+
+std::vector<uint32_t> allTables()
+{
+    static const uint8_t extra[] = {TB_QUEEN, TB_ROOK, TB_BISHOP, TB_KNIGHT, TB_PAWN};
+
+    std::vector<uint32_t> tables;
+    auto addTable = [&tables](std::initializer_list<uint8_t> pieces)
+    {
+        TBPosition pos;
+        for (uint8_t p : pieces)
+        {
+            pos.add(p, pos.count);
+        }
+        uint32_t material = normalizePosition(pos);
+        if (std::find(tables.begin(), tables.end(), material) == tables.end())
+        {
+            tables.push_back(material);
+        }
+    };
+
+    for (uint8_t x : extra)
+    {
+        addTable({TB_KING, TB_KING | TB_BLACK, x});
+    }
+    for (uint8_t x : extra)
+    {
+        for (uint8_t y : extra)
+        {
+            addTable({TB_KING, TB_KING | TB_BLACK, x, y});
+            addTable({TB_KING, TB_KING | TB_BLACK, x, static_cast<uint8_t>(y | TB_BLACK)});
+        }
+    }
+
+    // Fewer pieces first, then fewer pawns: captures and promotions lead into earlier tables
+    auto pawns = [](uint32_t material)
+    {
+        int count = 0;
+        for (int i = 0; i < TB_MAX_PIECES; i++) count += ((material >> (8 * i)) & 7) == TB_PAWN;
+        return count;
+    };
+    std::stable_sort(tables.begin(), tables.end(), [&pawns](uint32_t a, uint32_t b)
+                     { return pieceCount(a) != pieceCount(b) ? pieceCount(a) < pieceCount(b) : pawns(a) < pawns(b); });
+    return tables;
+}
+
+// --------------------------------------------------
+// Table files
+// --------------------------------------------------
+Tablebases::~Tablebases()
+{
+    for (auto &kv : tables)
+    {
+        if (kv.second.mapping != nullptr)
+        {
+            munmap(kv.second.mapping, kv.second.mapped_bytes);
+        }
+    }
+}
+
+std::size_t Tablebases::load(const std::string &directory)
+{
+    for (uint32_t material : allTables())
+    {
+        const std::string path = directory + "/" + tableName(material) + ".mtb";
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        const uint64_t entries = tableEntries(material);
+        struct stat st;
+        char magic[8];
+        uint64_t stored = 0;
+        if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != TABLE_HEADER_BYTES + entries ||
+            pread(fd, magic, 8, 0) != 8 || pread(fd, &stored, 8, 8) != 8 ||
+            std::memcmp(magic, TABLE_MAGIC, 8) != 0 || stored != entries)
+        {
+            std::cerr << "Ignoring damaged tablebase file " << path << std::endl;
+            ::close(fd);
+            continue;
+        }
+
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Error: failed to mmap tablebase " << path << std::endl;
+            continue;
+        }
+
+        Table &table = tables[material];
+        table.mapping = mapping;
+        table.mapped_bytes = st.st_size;
+        table.data = static_cast<const uint8_t *>(mapping) + TABLE_HEADER_BYTES;
+    }
+    return tables.size();
+}
+
+void Tablebases::attach(uint32_t material, const uint8_t *data)
+{
+    tables[material].data = data;
+}
+
+uint8_t Tablebases::value(TBPosition pos) const
+{
+    if (pos.count == 2)
+    {
+        return TB_DRAW; // bare kings
+    }
+    if (pos.count > TB_MAX_PIECES)
+    {
+        return TB_UNKNOWN;
+    }
+
+    const uint32_t material = normalizePosition(pos);
+    auto it = tables.find(material);
+    if (it == tables.end())
+    {
+        return TB_UNKNOWN;
+    }
+    return it->second.data[positionIndex(material, pos)];
+}
+
+bool writeTable(const std::string &path, const std::vector<uint8_t> &values)
+{
+    std::ofstream out(path, std::ios::binary);
+    const uint64_t entries = values.size();
+    out.write(TABLE_MAGIC, 8);
+    out.write(reinterpret_cast<const char *>(&entries), 8);
+    out.write(reinterpret_cast<const char *>(values.data()), values.size());
+    return static_cast<bool>(out);
+}
+
+// --------------------------------------------------
+// Process wide tables
+// --------------------------------------------------
+static Tablebases tablebases;
+
+bool openTablebases(const std::string &directory)
+{
+    std::size_t count = tablebases.load(directory);
+    if (count == 0)
+    {
+        std::cerr << "No tablebases found in " << directory << std::endl;
+        return false;
+    }
+    std::cout << "Tablebases loaded: " << count << " tables from " << directory << std::endl;
+    return true;
+}
+
+bool tablebasesLoaded()
+{
+    return tablebases.size() > 0;
+}
+
+bool probeTablebase(const uint64_t pieces[12], bool white_to_move, TBResult &result)
+{
+    TBPosition pos;
+    pos.white_to_move = white_to_move;
+    for (int i = 0; i < 12; i++)
+    {
+        const uint8_t piece = static_cast<uint8_t>(i < 6 ? (i + 1) | TB_BLACK : i - 5);
+        for (uint64_t bits = pieces[i]; bits != 0; bits &= bits - 1)
+        {
+            if (pos.count == TB_MAX_PIECES)
+            {
+                return false;
+            }
+            // Gigantua counts the files from h, the tables from a
+            pos.add(piece, __builtin_ctzll(bits) ^ 7);
+        }
+    }
+
+    const uint8_t value = tablebases.value(pos);
+    if (value == TB_UNKNOWN)
+    {
+        return false;
+    }
+    if (value == TB_DRAW)
+    {
+        result = {0, 0};
+    }
+    else if (value < TB_LOSS)
+    {
+        result = {1, value};
+    }
+    else
+    {
+        result = {-1, value - TB_LOSS};
+    }
+    return true;
+}
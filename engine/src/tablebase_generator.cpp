@@ -0,0 +1,491 @@
+// Offline endgame tablebase generator.
+//
+// Builds distance to mate tables (one byte per position, see tablebase.h) for every ending
+// with 3 and 4 pieces, kings included. Each table is solved by repeated passes over its
+// positions on several threads: pass n finds the positions won in n moves (a move into a
+// position lost in n - 1) and then the positions lost in n moves (every move leads into a
+// position won by the opponent). Captures and promotions are looked up in the tables built
+// before. Whatever is still unknown when the passes stop finding anything is a draw.
+// En passant captures are not generated, the search does not probe positions with an
+// en passant square.
+//
+// Usage: ./tablebase_generator [--out ../../data/tablebases] [--threads 8] [--max-pieces 4]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+#include "../include/tablebase.h"
+
+struct GeneratorOptions
+{
+    std::string out_dir = "../../data/tablebases";
+    int max_pieces = TB_MAX_PIECES;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+};
+
+static bool parseOptions(int argc, char **argv, GeneratorOptions &options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--out") options.out_dir = value;
+        else if (flag == "--threads") options.threads = std::max(1, std::stoi(value));
+        else if (flag == "--max-pieces") options.max_pieces = std::stoi(value);
+        else
+        {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            return false;
+        }
+    }
+    if (argc % 2 == 0)
+    {
+        std::cerr << "Missing value for option " << argv[argc - 1] << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --------------------------------------------------
+// Move generation on a mailbox board (a1 = 0)
+// --------------------------------------------------
+static const int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+static const int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+static bool onBoard(int file, int rank)
+{
+    return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+}
+
+static void fillBoard(const TBPosition &pos, uint8_t board[64])
+{
+    std::memset(board, 0, 64);
+    for (int i = 0; i < pos.count; i++)
+    {
+        board[pos.square[i]] = pos.piece[i];
+    }
+}
+
+// Is sq attacked by a piece of the given colour
+static bool attacked(const uint8_t board[64], int sq, bool byWhite)
+{
+    const uint8_t colour = byWhite ? 0 : TB_BLACK;
+    const int file = sq & 7;
+    const int rank = sq >> 3;
+
+    // Pawns attack diagonally forward
+    const int pawnRank = byWhite ? rank - 1 : rank + 1;
+    for (int df : {-1, 1})
+    {
+        if (onBoard(file + df, pawnRank) && board[pawnRank * 8 + file + df] == (TB_PAWN | colour))
+        {
+            return true;
+        }
+    }
+    for (const auto &step : KNIGHT_STEPS)
+    {
+        if (onBoard(file + step[0], rank + step[1]) && board[(rank + step[1]) * 8 + file + step[0]] == (TB_KNIGHT | colour))
+        {
+            return true;
+        }
+    }
+    for (const auto &step : KING_STEPS)
+    {
+        if (onBoard(file + step[0], rank + step[1]) && board[(rank + step[1]) * 8 + file + step[0]] == (TB_KING | colour))
+        {
+            return true;
+        }
+    }
+    // Sliders, the first four king steps are the rook directions
+    for (int d = 0; d < 8; d++)
+    {
+        const bool straight = (KING_STEPS[d][0] == 0 || KING_STEPS[d][1] == 0);
+        const uint8_t slider = straight ? TB_ROOK : TB_BISHOP;
+        int f = file + KING_STEPS[d][0];
+        int r = rank + KING_STEPS[d][1];
+        while (onBoard(f, r))
+        {
+            uint8_t piece = board[r * 8 + f];
+            if (piece != 0)
+            {
+                if (piece == (slider | colour) || piece == (TB_QUEEN | colour))
+                {
+                    return true;
+                }
+                break;
+            }
+            f += KING_STEPS[d][0];
+            r += KING_STEPS[d][1];
+        }
+    }
+    return false;
+}
+
+static int kingSquare(const TBPosition &pos, bool white)
+{
+    const uint8_t king = TB_KING | (white ? 0 : TB_BLACK);
+    for (int i = 0; i < pos.count; i++)
+    {
+        if (pos.piece[i] == king)
+        {
+            return pos.square[i];
+        }
+    }
+    return -1;
+}
+
+static bool inCheck(const TBPosition &pos, bool white)
+{
+    uint8_t board[64];
+    fillBoard(pos, board);
+    return attacked(board, kingSquare(pos, white), !white);
+}
+
+// Overlapping pieces, pawns on the first or last rank, or the side that just moved is in check
+static bool isLegalPosition(const TBPosition &pos)
+{
+    uint64_t occupied = 0;
+    for (int i = 0; i < pos.count; i++)
+    {
+        const uint64_t bit = 1ull << pos.square[i];
+        if ((occupied & bit) != 0)
+        {
+            return false;
+        }
+        occupied |= bit;
+        if ((pos.piece[i] & 7) == TB_PAWN && (pos.square[i] < 8 || pos.square[i] >= 56))
+        {
+            return false;
+        }
+    }
+    return !inCheck(pos, !pos.white_to_move);
+}
+
+// Adds the position after piece i moved to "to" (capturing whatever is there), if it is legal
+static void addChild(const TBPosition &pos, int i, int to, uint8_t promotion, std::vector<TBPosition> &children)
+{
+    TBPosition child;
+    child.white_to_move = !pos.white_to_move;
+    for (int j = 0; j < pos.count; j++)
+    {
+        if (j == i)
+        {
+            child.add(promotion != 0 ? promotion : pos.piece[j], to);
+        }
+        else if (pos.square[j] != to)
+        {
+            child.add(pos.piece[j], pos.square[j]);
+        }
+    }
+    if (!inCheck(child, pos.white_to_move))
+    {
+        children.push_back(child);
+    }
+}
+
+static void generateChildren(const TBPosition &pos, std::vector<TBPosition> &children)
+{
+    children.clear();
+    uint8_t board[64];
+    fillBoard(pos, board);
+    const uint8_t colour = pos.white_to_move ? 0 : TB_BLACK;
+    auto isOwn = [&](int sq) { return board[sq] != 0 && (board[sq] & TB_BLACK) == colour; };
+    auto isEnemy = [&](int sq) { return board[sq] != 0 && (board[sq] & TB_BLACK) != colour; };
+
+    for (int i = 0; i < pos.count; i++)
+    {
+        if ((pos.piece[i] & TB_BLACK) != colour)
+        {
+            continue;
+        }
+        const int type = pos.piece[i] & 7;
+        const int from = pos.square[i];
+        const int file = from & 7;
+        const int rank = from >> 3;
+
+        if (type == TB_PAWN)
+        {
+            const int forward = pos.white_to_move ? 1 : -1;
+            const int lastRank = pos.white_to_move ? 7 : 0;
+            auto pawnTo = [&](int to)
+            {
+                if ((to >> 3) == lastRank)
+                {
+                    for (uint8_t promoted : {TB_QUEEN, TB_ROOK, TB_BISHOP, TB_KNIGHT})
+                    {
+                        addChild(pos, i, to, static_cast<uint8_t>(promoted | colour), children);
+                    }
+                }
+                else
+                {
+                    addChild(pos, i, to, 0, children);
+                }
+            };
+
+            const int ahead = from + 8 * forward;
+            if (board[ahead] == 0)
+            {
+                pawnTo(ahead);
+                const int startRank = pos.white_to_move ? 1 : 6;
+                if (rank == startRank && board[ahead + 8 * forward] == 0)
+                {
+                    addChild(pos, i, ahead + 8 * forward, 0, children);
+                }
+            }
+            for (int df : {-1, 1})
+            {
+                if (onBoard(file + df, rank + forward) && isEnemy(ahead + df))
+                {
+                    pawnTo(ahead + df);
+                }
+            }
+            continue;
+        }
+
+        if (type == TB_KNIGHT || type == TB_KING)
+        {
+            const auto &steps = type == TB_KNIGHT ? KNIGHT_STEPS : KING_STEPS;
+            for (const auto &step : steps)
+            {
+                if (onBoard(file + step[0], rank + step[1]))
+                {
+                    const int to = (rank + step[1]) * 8 + file + step[0];
+                    if (!isOwn(to))
+                    {
+                        addChild(pos, i, to, 0, children);
+                    }
+                }
+            }
+            continue;
+        }
+
+        for (int d = 0; d < 8; d++)
+        {
+            const bool straight = (KING_STEPS[d][0] == 0 || KING_STEPS[d][1] == 0);
+            if ((type == TB_ROOK && !straight) || (type == TB_BISHOP && straight))
+            {
+                continue;
+            }
+            int f = file + KING_STEPS[d][0];
+            int r = rank + KING_STEPS[d][1];
+            while (onBoard(f, r) && !isOwn(r * 8 + f))
+            {
+                addChild(pos, i, r * 8 + f, 0, children);
+                if (board[r * 8 + f] != 0)
+                {
+                    break;
+                }
+                f += KING_STEPS[d][0];
+                r += KING_STEPS[d][1];
+            }
+        }
+    }
+}
+
+// --------------------------------------------------
+// Solving one table
+// --------------------------------------------------
+
+// Runs work(first, last, updates) over blocks of the index range on all threads,
+// returns the (index, value) updates the threads collected
+template <class Work>
+static std::vector<std::pair<uint64_t, uint8_t>> parallelPass(uint64_t entries, int threads, Work work)
+{
+    constexpr uint64_t BLOCK = 1 << 14;
+    std::atomic<uint64_t> next{0};
+    std::mutex merge_mutex;
+    std::vector<std::pair<uint64_t, uint8_t>> updates;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]()
+                             {
+                                 std::vector<std::pair<uint64_t, uint8_t>> local;
+                                 for (uint64_t first = next.fetch_add(BLOCK); first < entries; first = next.fetch_add(BLOCK))
+                                 {
+                                     work(first, std::min(first + BLOCK, entries), local);
+                                 }
+                                 std::lock_guard<std::mutex> lock(merge_mutex);
+                                 updates.insert(updates.end(), local.begin(), local.end()); });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return updates;
+}
+
+static std::vector<uint8_t> solveTable(uint32_t material, Tablebases &tables, int threads)
+{
+    const uint64_t entries = tableEntries(material);
+    std::vector<uint8_t> values(entries, TB_UNKNOWN);
+    tables.attach(material, values.data()); // the passes look up moves within the ending through tables
+
+    // 0. Illegal positions, mates and stalemates. Also the longest mate reachable through a
+    //    capture or promotion: passes go on at least that long.
+    std::atomic<int> deepest_exit{0};
+    parallelPass(entries, threads, [&](uint64_t first, uint64_t last, auto &)
+                 {
+                     std::vector<TBPosition> children;
+                     int deepest = 0;
+                     for (uint64_t index = first; index < last; index++)
+                     {
+                         TBPosition pos;
+                         decodeIndex(material, index, pos);
+                         if (!isLegalPosition(pos))
+                         {
+                             values[index] = TB_DRAW;
+                             continue;
+                         }
+                         generateChildren(pos, children);
+                         if (children.empty())
+                         {
+                             values[index] = inCheck(pos, pos.white_to_move) ? TB_LOSS : TB_DRAW;
+                             continue;
+                         }
+                         for (const TBPosition &child : children)
+                         {
+                             TBPosition normalized = child;
+                             if (normalizePosition(normalized) == material)
+                             {
+                                 continue;
+                             }
+                             // Capture or promotion, the table it leads into is complete
+                             uint8_t value = tables.value(child);
+                             if (value != TB_UNKNOWN && value != TB_DRAW)
+                             {
+                                 deepest = std::max(deepest, value < TB_LOSS ? value : value - TB_LOSS);
+                             }
+                         }
+                     }
+                     int seen = deepest_exit.load();
+                     while (deepest > seen && !deepest_exit.compare_exchange_weak(seen, deepest))
+                     {
+                     } });
+
+    // 1. Pass n: first the wins in n, then the losses in n (they need all wins in n)
+    int longest = 0;
+    for (int n = 1; n < TB_LOSS - 1; n++)
+    {
+        auto wins = parallelPass(entries, threads, [&](uint64_t first, uint64_t last, auto &updates)
+                                 {
+                                     std::vector<TBPosition> children;
+                                     for (uint64_t index = first; index < last; index++)
+                                     {
+                                         if (values[index] != TB_UNKNOWN) continue;
+                                         TBPosition pos;
+                                         decodeIndex(material, index, pos);
+                                         generateChildren(pos, children);
+                                         for (const TBPosition &child : children)
+                                         {
+                                             if (tables.value(child) == TB_LOSS + n - 1)
+                                             {
+                                                 updates.emplace_back(index, static_cast<uint8_t>(n));
+                                                 break;
+                                             }
+                                         }
+                                     } });
+        for (const auto &update : wins)
+        {
+            values[update.first] = update.second;
+        }
+
+        auto losses = parallelPass(entries, threads, [&](uint64_t first, uint64_t last, auto &updates)
+                                   {
+                                       std::vector<TBPosition> children;
+                                       for (uint64_t index = first; index < last; index++)
+                                       {
+                                           if (values[index] != TB_UNKNOWN) continue;
+                                           TBPosition pos;
+                                           decodeIndex(material, index, pos);
+                                           generateChildren(pos, children);
+                                           bool lost = true;
+                                           for (const TBPosition &child : children)
+                                           {
+                                               uint8_t value = tables.value(child);
+                                               if (value == TB_DRAW || value > n)
+                                               {
+                                                   lost = false; // a draw, an unknown result, a loss of the opponent or a longer win
+                                                   break;
+                                               }
+                                           }
+                                           if (lost)
+                                           {
+                                               updates.emplace_back(index, static_cast<uint8_t>(TB_LOSS + n));
+                                           }
+                                       } });
+        for (const auto &update : losses)
+        {
+            values[update.first] = update.second;
+        }
+
+        if (!wins.empty() || !losses.empty())
+        {
+            longest = n;
+        }
+        else if (n > deepest_exit + 1)
+        {
+            break;
+        }
+    }
+
+    // 2. Nothing forces a mate from the rest
+    uint64_t won = 0, drawn = 0, lost = 0;
+    for (uint8_t &value : values)
+    {
+        if (value == TB_UNKNOWN) value = TB_DRAW;
+        if (value == TB_DRAW) drawn++;
+        else if (value < TB_LOSS) won++;
+        else lost++;
+    }
+    std::cout << tableName(material) << ": " << won << " won, " << lost << " lost, " << drawn << " drawn or illegal, longest mate "
+              << longest << " moves" << std::endl;
+    return values;
+}
+
+int main(int argc, char **argv)
+{
+    GeneratorOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+    mkdir(options.out_dir.c_str(), 0755);
+
+    // Tables already on disk are reused, so an interrupted run can be continued
+    Tablebases tables;
+    tables.load(options.out_dir);
+    std::vector<std::vector<uint8_t>> solved; // attached to tables, must outlive them
+    solved.reserve(allTables().size());
+
+    for (uint32_t material : allTables())
+    {
+        const std::string name = tableName(material);
+        const std::string path = options.out_dir + "/" + name + ".mtb";
+        struct stat st;
+        if (static_cast<int>(name.size()) - 1 > options.max_pieces || stat(path.c_str(), &st) == 0)
+        {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        solved.push_back(solveTable(material, tables, options.threads));
+        if (!writeTable(path, solved.back()))
+        {
+            std::cerr << "Error: cannot write " << path << std::endl;
+            return 1;
+        }
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Wrote " << path << " in " << seconds << " s" << std::endl;
+    }
+    return 0;
+}
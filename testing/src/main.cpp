@@ -5,6 +5,8 @@
 #include <cmath>
 #include "../../training/include/chessnet.h"
 #include "../../training/include/data_loader.h"
+#include "../../training/include/quantization.h"
+#include "../../training/include/int8_inference.h"
 
 // This function loads a trained model from disk into 'net'
 bool load_model(ChessNet &net, const std::string &model_path, torch::Device device)
@@ -67,12 +69,46 @@ int main()
     const int num_test_batches = validation_dataset_size / test_batch_size;
     int last_rowid = training_dataset_size + validation_dataset_size; // start of test data
 
+    // 5b) Int8 copy of the model: the one quantization aware training (training --qat) wrote for
+    // these weights, otherwise calibrated on a sample of the (shuffled) training rows
+    const int calibration_batches = 16;
+    const uint64_t fingerprint = weightsFingerprint(*net);
+    const std::string int8_path = Int8Inference::filePath("../../training/NN_weights", fingerprint);
+    Int8Inference::Network quantized;
+    if (quantized.load(int8_path, fingerprint))
+    {
+        std::cout << "Int8 model loaded from " << int8_path << std::endl;
+    }
+    else
+    {
+        std::vector<torch::Tensor> calibration;
+        int calibration_rowid = 0;
+        for (int i = 0; i < calibration_batches; ++i)
+        {
+            BatchData batch_data = load_data(db, test_batch_size, calibration_rowid, net, device);
+            calibration_rowid = batch_data.last_rowid;
+            if (batch_data.inputs.size(0) > 0)
+            {
+                calibration.push_back(batch_data.inputs);
+            }
+        }
+        if (!quantizeInt8(net->foldedLayers(), calibration, int8_path, fingerprint) ||
+            !quantized.load(int8_path, fingerprint))
+        {
+            std::cerr << "Failed to quantize the model. Exiting.\n";
+            return 1;
+        }
+        std::cout << "Int8 model written to " << int8_path << std::endl;
+    }
+
     // Variables for accumulating metrics across batches
     double total_sse = 0.0;  // Sum of Squared Errors (for MSE)
     double total_mae = 0.0;  // Sum of Absolute Errors
     double sum_targets = 0.0;
     double sum_targets_sq = 0.0;
     int64_t total_samples = 0;
+    double int8_sse = 0.0;      // Int8 model against the targets
+    double int8_drift_sse = 0.0; // Int8 model against the float model
 
     // 6) Prepare CSV file for predictions/targets
     // Make sure to check you have enough space if your test set is very large.
@@ -83,7 +119,7 @@ int main()
         return 1;
     }
     // Write CSV header
-    csv_file << "prediction,target\n";
+    csv_file << "prediction,int8_prediction,target\n";
 
     // 7) Loop over test batches
     for (int batch_idx = 0; batch_idx < num_test_batches; ++batch_idx)
@@ -133,9 +169,24 @@ int main()
         float* preds_data   = preds_cpu.data_ptr<float>();
         float* targets_data = targets_cpu.data_ptr<float>();
 
+        // Int8 kernel, one position at a time as the engine evaluates them (spread over the CPU threads)
+        auto inputs_cpu = batch_data.inputs.to(torch::kCPU, torch::kFloat32).contiguous();
+        const float *inputs_data = inputs_cpu.data_ptr<float>();
+        const int64_t input_size = inputs_cpu[0].numel();
+        std::vector<float> int8_predictions(batch_size);
+        at::parallel_for(0, batch_size, 16, [&](int64_t begin, int64_t end)
+                         {
+                             for (int64_t i = begin; i < end; ++i)
+                             {
+                                 int8_predictions[i] = quantized.forward(inputs_data + i * input_size);
+                             } });
+
         for (int i = 0; i < batch_size; ++i)
         {
-            csv_file << preds_data[i] << "," << targets_data[i] << "\n";
+            float int8_prediction = int8_predictions[i];
+            int8_sse += std::pow(int8_prediction - targets_data[i], 2);
+            int8_drift_sse += std::pow(int8_prediction - preds_data[i], 2);
+            csv_file << preds_data[i] << "," << int8_prediction << "," << targets_data[i] << "\n";
         }
 
         // (Optional) Print MSE for this batch
@@ -179,6 +230,10 @@ int main()
         std::cout << "  * RMSE:        " << rmse   << "\n";
         std::cout << "  * MAE:         " << mae    << "\n";
         std::cout << "  * R^2 Score:   " << r2     << "\n";
+        std::cout << "Int8 quantized model:\n";
+        std::cout << "  * Average MSE: " << int8_sse / static_cast<double>(total_samples)
+                  << " (float " << avg_mse << ")\n";
+        std::cout << "  * MSE to the float model: " << int8_drift_sse / static_cast<double>(total_samples) << "\n";
         std::cout << "========================================\n";
     }
     else
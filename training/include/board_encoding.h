@@ -0,0 +1,44 @@
+#ifndef BOARD_ENCODING_H
+#define BOARD_ENCODING_H
+
+#include <cstddef>
+#include <cstdint>
+
+// ----------------------------------------------
+// libtorch free encoding of bitboards into network inputs.
+//
+// Every bitboard becomes 64 floats, square s at index s, written straight into the caller's
+// buffer (a tensor's storage, a stack array) without intermediate vectors. A bitboard is
+// expanded 16 squares at a time with AVX-512 masked moves, 8 at a time with an AVX2 compare
+// per byte, or bit by bit.
+// ----------------------------------------------
+namespace BoardEncoding
+{
+    constexpr int SQUARES = 64;
+    constexpr int BITBOARDS = 13;                       // WPawn..WKing, BPawn..BKing, en passant
+    constexpr int PLANES_SIZE = BITBOARDS * SQUARES;    // ChessNetConv / ChessNetConv2 input, [13, 8, 8]
+    constexpr int FEATURES_SIZE = BITBOARDS * SQUARES + 5; // ChessNetLinear input, then castling and side to move
+
+    // Value of a set square in each plane of planes()
+    constexpr float PLANE_VALUES[BITBOARDS] = {1, 3, 3, 5, 9, 10, -1, -3, -3, -5, -9, -10, 1};
+
+    // value on the set squares of bits, 0 on the others (all 64 are written)
+    void expand(std::uint64_t bits, float value, float *squares);
+
+    /**
+     * @brief ChessNetConv input planes: piece values (pawn 1, knight and bishop 3, rook 5,
+     *        queen 9, king 10, negative for the opponent), 1 on the en passant square.
+     * @param bitboards the 12 piece bitboards (own pieces first) and the en passant bitboard
+     * @param planes PLANES_SIZE floats
+     */
+    void planes(const std::uint64_t bitboards[BITBOARDS], float *planes);
+
+    /**
+     * @brief ChessNetLinear input: 1 for own pieces and en passant, -1 for the opponent's,
+     *        then MyCastleL, MyCastleR, EnemyCastleL, EnemyCastleR and WhiteMove as 0 or 1.
+     * @param features FEATURES_SIZE floats
+     */
+    void features(const std::uint64_t bitboards[BITBOARDS], const bool flags[5], float *features);
+}
+
+#endif // BOARD_ENCODING_H
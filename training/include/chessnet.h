@@ -63,6 +63,7 @@
 #include <sqlite3.h>
 #include <vector>
 #include <cstdint>
+#include <string>
 
 struct BatchData
 {
@@ -121,6 +122,21 @@ std::vector<std::vector<int>> intToBitboard(uint64_t bitboard, int value);
 
 std::vector<int> intToVector64White(uint64_t bitboard);
 
+// One layer of a network with the BatchNorms around it folded in (eval mode statistics)
+struct FoldedLayer
+{
+    enum Kind
+    {
+        Conv3x3, // 3x3, padding 1, on 8x8 planes
+        Linear
+    };
+
+    Kind kind;
+    torch::Tensor weight; // [out][in][3][3] or [out][in]
+    torch::Tensor bias;   // [out]
+    bool relu;            // ReLU after the layer, tanh if false (the output layer)
+};
+
 // ----------------------------------------------
 // Convolution-based ChessNet (updated as a class)
 // ----------------------------------------------
@@ -139,6 +155,13 @@ public:
     // Optional static helper for converting bitboards to a tensor
     torch::Tensor toTensor(const ChessPosition &position);
 
+    // The network as plain layers, every BatchNorm folded into the layer in front of it
+    std::vector<FoldedLayer> foldedLayers();
+
+    // Writes the weights with every BatchNorm folded in (running statistics) for
+    // ConvInference::Network, tagged with the fingerprint of these weights
+    bool exportFolded(const std::string &path, uint64_t fingerprint);
+
 private:
     // Convolutional layers
     torch::nn::Conv2d conv1, conv2, conv3, conv4;
@@ -156,6 +179,9 @@ private:
 // This macro will create a typedef: using ChessNet = std::shared_ptr<ChessNetConv>;
 TORCH_MODULE(ChessNetConv);
 
+// Hash of the weights of a network (parameters and buffers), tags files derived from them
+uint64_t weightsFingerprint(torch::nn::Module &module);
+
 // ----------------------------------------------
 // Linear ChessNet
 // ----------------------------------------------
@@ -173,6 +199,9 @@ public:
 
     std::vector<int> loadBitboard(uint64_t bitboard, bool isEnemy);
 
+    // The network as plain layers, every BatchNorm folded into the layer in front of it
+    std::vector<FoldedLayer> foldedLayers();
+
 private:
     // Linear layers
     torch::nn::Linear fc1;
@@ -229,34 +258,52 @@ enum MoveType {
 };
 
 // ------------------------------------------------------------
-// Function to calculate the HalfKP feature index
+// Function to calculate the HalfKP feature index (NNUEInference::featureIndex): squares as
+// the perspective sees them, pieceType PAWN..QUEEN, isWhite for the perspective's own pieces
 uint32_t calculateHalfKPIndex(uint64_t kingSquare, uint64_t pieceSquare,
                               PieceType pieceType, bool isWhite);
 // ------------------------------------------------------------
 
 // ------------------------------------------------------------
-// Define the NNUE HalfKP network architecture
+// Define the NNUE HalfKP network architecture: a feature transformer shared by both
+// perspectives, clipped ReLU, then 512 -> 32 -> 32 -> 1. The engine runs it incrementally
+// (NNUEInference) from the file exportQuantized writes.
+// Inputs are the indices of the active features, not a 41024 wide one-hot vector: the
+// feature transformer is an EmbeddingBag summing the weight rows of at most 30 pieces
 // ------------------------------------------------------------
 struct NNUEHalfKPImpl : torch::nn::Module {
+    // Stored in every checkpoint. Version 2 is the EmbeddingBag feature transformer without
+    // BatchNorms, checkpoints of the earlier one-hot Linear network (no version) cannot be loaded.
+    static constexpr int64_t ARCHITECTURE_VERSION = 2;
+
     // Default constructor (with some hard-coded values)
     NNUEHalfKPImpl();
 
-    // Forward pass
+    // Checkpoints carry ARCHITECTURE_VERSION, loading one of another architecture fails with a clear error
+    void save(torch::serialize::OutputArchive &archive) const override;
+    void load(torch::serialize::InputArchive &archive) override;
+
+    // Forward pass, x is int64 [batch, 2, MAX_ACTIVE]: active feature indices of the side to
+    // move, then of the opponent, padded with 0 (never a feature)
     torch::Tensor forward(torch::Tensor x);
 
     // Initialize weights
     void initialize_weights();
 
-    // Convert ChessPosition to a tensor of HalfKP feature indices
+    // Convert ChessPosition to the [2, MAX_ACTIVE] HalfKP feature indices of both perspectives
     torch::Tensor toTensor(const ChessPosition &position);
 
+    // Writes the quantized weights for NNUEInference::Network
+    bool exportQuantized(const std::string &path);
+
 private:
     // Layers
+    torch::nn::EmbeddingBag ft{nullptr}; // Weight [41024, HIDDEN], the column layout of NNUEInference
+    torch::Tensor ft_bias;
     torch::nn::Linear fc1{nullptr}, fc2{nullptr}, fc3{nullptr};
-    torch::nn::BatchNorm1d bn1{nullptr}, bn2{nullptr}, bn3{nullptr};
 
-    // Function to calculate the HalfKP input vector
-    std::vector<int64_t> createHalfKPInputVector(const ChessPosition &position);
+    // Function to calculate the HalfKP input vector of one perspective (NNUEInference::WHITE is the side to move)
+    std::vector<int64_t> createHalfKPInputVector(const ChessPosition &position, int perspective);
 };
 
 // Torch’s macro that defines a module holder class (NNUEHalfKP)
@@ -281,6 +328,9 @@ public:
     // Optional static helper for converting bitboards to a tensor
     torch::Tensor toTensor(const ChessPosition &position);
 
+    // The network as plain layers, every BatchNorm folded into the layer in front of it
+    std::vector<FoldedLayer> foldedLayers();
+
 private:
     // Convolutional layers
     torch::nn::Conv2d conv1, conv2;
@@ -301,5 +351,14 @@ TORCH_MODULE(ChessNetConv2);
 // using ChessNet = ChessNetLinear;
 using ChessNet = ChessNetConv;
 // using ChessNet = ChessNetConv2;
+// using ChessNet = NNUEHalfKP;
+
+/**
+ * @brief Inputs of the positions as one [batch, ...] tensor on the CPU, the same as stacking
+ *        net->toTensor of each. Planes and features are encoded straight into its storage.
+ *        Defined for ChessNetConv, ChessNetConv2, ChessNetLinear and NNUEHalfKP.
+ */
+template <class Net>
+torch::Tensor toBatch(Net &net, const std::vector<ChessPosition> &positions);
 
 #endif // CHESSNET_H
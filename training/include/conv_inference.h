@@ -0,0 +1,114 @@
+#ifndef CONV_INFERENCE_H
+#define CONV_INFERENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ----------------------------------------------
+// libtorch free forward pass of ChessNetConv for the engine.
+//
+// Every BatchNorm is folded into the layer in front of it (conv_flat_bn into fc1), so the
+// network is four 3x3 convolutions with ReLU, two fully connected layers with ReLU and one
+// with tanh. The weights come from ChessNetConvImpl::exportFolded and are memory mapped.
+// Activations are channel major, 64 floats per channel (one per board square).
+//
+// The input planes are sparse (at most 32 pieces and an en passant square), so conv1 can also
+// be kept as an accumulator: a piece adds its value times one 3x3 kernel tap to each of the
+// (up to) 9 squares whose window covers it, CONV1 channels at a time. Along a search the
+// accumulator is updated by removing and adding the pieces a move changes, and evaluating
+// starts at conv2.
+// ----------------------------------------------
+namespace ConvInference
+{
+    constexpr int INPUT_PLANES = 13;
+    constexpr int CONV1 = 64;
+    constexpr int CONV2 = 128;
+    constexpr int CONV3 = 256;
+    constexpr int CONV4 = 512;
+    constexpr int FC1 = 1024;
+    constexpr int FC2 = 256;
+    constexpr int SQUARES = 64;
+
+    // Folded weight file: 64 byte header (magic, fingerprint of the source weights), then the
+    // float arrays in this order: conv1..conv4 weight [out][in][3][3] and bias, fc1..fc3 weight
+    // [out][in] and bias
+    constexpr char FILE_MAGIC[8] = {'M', 'S', 'L', 'C', 'N', 'V', '0', '1'};
+    constexpr std::size_t HEADER_BYTES = 64;
+
+    constexpr std::size_t convFloats(int in, int out) { return static_cast<std::size_t>(out) * in * 9 + out; }
+    constexpr std::size_t linearFloats(int in, int out) { return static_cast<std::size_t>(out) * in + out; }
+    constexpr std::size_t TOTAL_FLOATS =
+        convFloats(INPUT_PLANES, CONV1) + convFloats(CONV1, CONV2) + convFloats(CONV2, CONV3) + convFloats(CONV3, CONV4) +
+        linearFloats(CONV4 * SQUARES, FC1) + linearFloats(FC1, FC2) + linearFloats(FC2, 1);
+
+    constexpr int WHITE = 0;
+    constexpr int BLACK = 1;
+
+    /**
+     * @brief conv1 before its ReLU (bias included, en passant plane left out) for both
+     *        perspectives. The white perspective is the input with white to move, the black one
+     *        the board flipped vertically with the colours swapped, as the network sees it with
+     *        black to move. Square major: channel c of square s at s * CONV1 + c.
+     */
+    struct alignas(64) Accumulator
+    {
+        float values[2][SQUARES * CONV1]; // [perspective]
+    };
+
+    class Network
+    {
+    public:
+        Network() = default;
+        ~Network();
+        Network(const Network &) = delete;
+        Network &operator=(const Network &) = delete;
+
+        // Maps a folded weight file, false if it is missing, damaged or not of these weights
+        bool load(const std::string &path, std::uint64_t fingerprint);
+        bool loaded() const { return mapping != nullptr; }
+
+        /**
+         * @brief Output of the network for the 13 input planes, the same as ChessNetConvImpl::forward
+         *        on toTensor of the position (side to move's view). Thread safe, the scratch
+         *        buffers are per thread.
+         * @param planes INPUT_PLANES * 64 floats, plane p square s at p * 64 + s (BoardEncoding::planes)
+         */
+        float forward(const float *planes) const;
+
+        /**
+         * @brief Recomputes one perspective of the accumulator from the pieces on the board.
+         * @param pieces WPawn, WKnight, WBishop, WRook, WQueen, WKing, then the same for black
+         */
+        void refresh(Accumulator &accumulator, const std::uint64_t pieces[12], int perspective) const;
+
+        // Accumulator after a move from the one before it, pieces before and after the move
+        void update(const Accumulator &before, Accumulator &after,
+                    const std::uint64_t pieces_before[12], const std::uint64_t pieces_after[12]) const;
+
+        /**
+         * @brief The same output as forward, from the accumulator of the position.
+         * @param en_passant en passant bitboard of the board (white's view, not flipped)
+         */
+        float forward(const Accumulator &accumulator, bool white_to_move, std::uint64_t en_passant) const;
+
+    private:
+        struct Layer
+        {
+            const float *weight = nullptr;
+            const float *bias = nullptr;
+        };
+
+        void *mapping = nullptr;
+        std::size_t mapped_bytes = 0;
+        Layer conv[4];
+        Layer fc[3];
+        std::vector<float> conv1_taps; // [plane][tap][channel]: plane value * conv1 weight
+
+        // conv2 onwards, conv1's output (after ReLU, channel major) in a; b and shifted are scratch
+        float afterConv1(float *a, float *b, float *shifted) const;
+    };
+}
+
+#endif // CONV_INFERENCE_H
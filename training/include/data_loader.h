@@ -12,6 +12,15 @@ struct ChessData {
     float evaluation;
 };
 
+struct PositionBatch {
+    std::vector<ChessPosition> positions; // Seen by the side to move
+    std::vector<float> targets;           // eval_scaled, from the side to move
+    int64_t last_rowid = 0;
+};
+
+// Rows after lastRowid as positions, for encoding them for more than one network (distillation)
+PositionBatch load_positions(sqlite3* db, int batch_size, int lastRowid);
+
 // Function to load chess positions and evaluations from the SQLite database
 BatchData load_data(sqlite3* db, int batch_size, int batch, ChessNet net, torch::Device device);
 
@@ -0,0 +1,26 @@
+#ifndef FROZEN_MODEL_H
+#define FROZEN_MODEL_H
+
+#include <torch/torch.h>
+#include <torch/script.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chessnet.h"
+
+// ----------------------------------------------
+// Frozen TorchScript form of a folded network, for inference only.
+//
+// The layers (every BatchNorm already folded into the conv / linear layer in front of it) are
+// registered on a script module, its forward is defined from them and the module is frozen:
+// the weights become constants of the graph, so no BatchNorm, no training branch and no debug
+// output is left. The fingerprint of the source weights is kept in the archive.
+// ----------------------------------------------
+
+// Writes the frozen module of layers (on their device) to path
+bool exportFrozen(const std::vector<FoldedLayer> &layers, const std::string &path, uint64_t fingerprint);
+
+// Loads a frozen module onto device, false if it is missing, unreadable or of other weights
+bool loadFrozen(const std::string &path, uint64_t fingerprint, torch::Device device, torch::jit::Module &module);
+
+#endif // FROZEN_MODEL_H
@@ -0,0 +1,106 @@
+#ifndef INT8_INFERENCE_H
+#define INT8_INFERENCE_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// ----------------------------------------------
+// libtorch free int8 forward pass of a post-training quantized network (quantizeInt8).
+//
+// The network is a chain of folded layers (3x3 convolutions on 8x8 planes, then linear
+// layers), the same for ChessNetConv, ChessNetConv2 and ChessNetLinear. Weights are int8
+// with one scale per output channel, the input of every layer is quantized to 0..127 with
+// a scale and zero point calibrated on sample positions, products are summed in int32
+// (VNNI, AVX2 maddubs or scalar) and scaled back to float before the activation.
+// ----------------------------------------------
+namespace Int8Inference
+{
+    // File: 64 byte header, then per layer a 64 byte descriptor followed by its int8 weights
+    // [out][k_padded], float weight scales [out] and float biases [out], padded to 64 bytes
+    constexpr char FILE_MAGIC[8] = {'M', 'S', 'L', 'I', 'N', 'T', '8', '1'};
+    constexpr std::size_t HEADER_BYTES = 64;
+    constexpr std::size_t DESCRIPTOR_BYTES = 64;
+    constexpr int K_ALIGN = 64; // Rows of the weights are padded to a multiple of this
+    constexpr int QUANT_MAX = 127; // Activations stay below 128 so u8 * s8 pairs never saturate int16
+
+    enum LayerKind : std::uint32_t
+    {
+        CONV3X3 = 0,
+        LINEAR = 1
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint64_t fingerprint;
+        std::uint32_t layer_count;
+        std::uint32_t input_size; // Floats of network input
+    };
+
+    struct LayerDescriptor
+    {
+        std::uint32_t kind;
+        std::uint32_t in;  // Input channels (conv) or features (linear)
+        std::uint32_t out; // Output channels or features
+        std::uint32_t relu; // ReLU after the layer, else tanh
+        std::uint32_t k; // Length of a weight row: in * 9 or in
+        std::uint32_t k_padded;
+        float input_scale; // input = input_scale * (q - input_zero)
+        std::int32_t input_zero;
+    };
+
+    constexpr std::size_t padded(std::size_t bytes) { return (bytes + 63) / 64 * 64; }
+
+    // File of the quantized float weights with this fingerprint in directory, named per source
+    // model so the quantizations of different models never overwrite each other
+    inline std::string filePath(const std::string &directory, std::uint64_t fingerprint)
+    {
+        char name[40];
+        std::snprintf(name, sizeof(name), "model_int8_%016" PRIx64 ".bin", fingerprint);
+        return directory + "/" + name;
+    }
+
+    class Network
+    {
+    public:
+        Network() = default;
+        ~Network();
+        Network(const Network &) = delete;
+        Network &operator=(const Network &) = delete;
+
+        // Maps a quantized network file, false if it is missing, damaged or not of these weights
+        bool load(const std::string &path, std::uint64_t fingerprint);
+        bool loaded() const { return mapping != nullptr; }
+        std::size_t inputSize() const { return input_size; }
+
+        /**
+         * @brief Output of the network for one input, laid out as the model's toTensor
+         *        (13 planes of 64 squares for the convolutional networks, 837 features for
+         *        ChessNetLinear). Thread safe, the scratch buffers are per thread.
+         */
+        float forward(const float *input) const;
+
+    private:
+        struct Layer
+        {
+            LayerDescriptor shape;
+            const std::int8_t *weight = nullptr;
+            const float *weight_scale = nullptr;
+            const float *bias = nullptr;
+            std::vector<std::int32_t> row_sum; // Sum of each weight row, to take the zero point out
+        };
+
+        void *mapping = nullptr;
+        std::size_t mapped_bytes = 0;
+        std::size_t input_size = 0;
+        std::size_t largest_activation = 0;
+        std::size_t largest_input = 0;
+        std::vector<Layer> layers;
+    };
+}
+
+#endif // INT8_INFERENCE_H
@@ -0,0 +1,124 @@
+#ifndef INT8_KERNELS_H
+#define INT8_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// u8 * s8 dot product kernels shared by the int8 networks (Int8Inference, NNUEInference).
+// Activations must stay below 128 so the AVX2 maddubs pairs never saturate int16.
+namespace Int8Kernels
+{
+    // ------------------------------------------
+    // u8 * s8 dot products of ROWS weight rows with one activation vector, k a multiple of 64
+    // ------------------------------------------
+    constexpr int ROWS = 4;
+
+#if defined(__AVX512BW__)
+    inline __m512i dpbusd(__m512i acc, __m512i a, __m512i w)
+    {
+#if defined(__AVX512VNNI__)
+        return _mm512_dpbusd_epi32(acc, a, w);
+#else
+        const __m512i pairs = _mm512_maddubs_epi16(a, w);
+        return _mm512_add_epi32(acc, _mm512_madd_epi16(pairs, _mm512_set1_epi16(1)));
+#endif
+    }
+
+    inline void dotRows(const std::int8_t *weight, std::size_t k, const std::uint8_t *in, std::int32_t *out)
+    {
+        __m512i acc[ROWS];
+        for (int r = 0; r < ROWS; r++)
+        {
+            acc[r] = _mm512_setzero_si512();
+        }
+        for (std::size_t i = 0; i < k; i += 64)
+        {
+            const __m512i a = _mm512_loadu_si512(in + i);
+            for (int r = 0; r < ROWS; r++)
+            {
+                acc[r] = dpbusd(acc[r], a, _mm512_loadu_si512(weight + r * k + i));
+            }
+        }
+        for (int r = 0; r < ROWS; r++)
+        {
+            out[r] = _mm512_reduce_add_epi32(acc[r]);
+        }
+    }
+#elif defined(__AVX2__)
+    inline __m256i dpbusd(__m256i acc, __m256i a, __m256i w)
+    {
+#if defined(__AVXVNNI__)
+        return _mm256_dpbusd_avx_epi32(acc, a, w);
+#else
+        const __m256i pairs = _mm256_maddubs_epi16(a, w);
+        return _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+#endif
+    }
+
+    inline std::int32_t hsum(__m256i v)
+    {
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        return _mm_cvtsi128_si32(s);
+    }
+
+    inline void dotRows(const std::int8_t *weight, std::size_t k, const std::uint8_t *in, std::int32_t *out)
+    {
+        __m256i acc[ROWS];
+        for (int r = 0; r < ROWS; r++)
+        {
+            acc[r] = _mm256_setzero_si256();
+        }
+        for (std::size_t i = 0; i < k; i += 32)
+        {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            for (int r = 0; r < ROWS; r++)
+            {
+                acc[r] = dpbusd(acc[r], a, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weight + r * k + i)));
+            }
+        }
+        for (int r = 0; r < ROWS; r++)
+        {
+            out[r] = hsum(acc[r]);
+        }
+    }
+#else
+    inline void dotRows(const std::int8_t *weight, std::size_t k, const std::uint8_t *in, std::int32_t *out)
+    {
+        for (int r = 0; r < ROWS; r++)
+        {
+            std::int32_t sum = 0;
+            for (std::size_t i = 0; i < k; i++)
+            {
+                sum += static_cast<std::int32_t>(in[i]) * weight[r * k + i];
+            }
+            out[r] = sum;
+        }
+    }
+#endif
+
+    // acc[o] = weight[o] . in for all rows, the last block may be short
+    inline void gemv(const std::int8_t *weight, std::size_t rows, std::size_t k, const std::uint8_t *in, std::int32_t *acc)
+    {
+        std::size_t o = 0;
+        for (; o + ROWS <= rows; o += ROWS)
+        {
+            dotRows(weight + o * k, k, in, acc + o);
+        }
+        for (; o < rows; o++)
+        {
+            std::int32_t sum = 0;
+            for (std::size_t i = 0; i < k; i++)
+            {
+                sum += static_cast<std::int32_t>(in[i]) * weight[o * k + i];
+            }
+            acc[o] = sum;
+        }
+    }
+}
+
+#endif // INT8_KERNELS_H
@@ -0,0 +1,107 @@
+#ifndef NNUE_INFERENCE_H
+#define NNUE_INFERENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ----------------------------------------------
+// libtorch free, incrementally updated forward pass of NNUEHalfKP.
+//
+// HalfKP features: for each perspective (white, black) every non-king piece on the board is
+// one feature, indexed by the perspective's own king square, the piece (own or opponent's
+// pawn..queen) and its square. The black perspective sees the board flipped vertically, so
+// both perspectives look like white's. The first layer (feature transformer) is shared by
+// the two perspectives; its output, the accumulator, is a sum of weight columns and is kept
+// up to date by adding and removing the columns of the pieces a move changes. Only a king
+// move refreshes its perspective from scratch. The small dense layers after it run on the
+// clipped accumulators of the side to move and of the opponent, in that order.
+// ----------------------------------------------
+namespace NNUEInference
+{
+    constexpr int KING_SQUARES = 64;
+    constexpr int PIECE_KINDS = 10;                                 // own pawn..queen, opponent pawn..queen
+    constexpr int FEATURES_PER_KING = PIECE_KINDS * 64 + 1;         // Index 0 of every king is unused (as in Shogi's BonaPiece)
+    constexpr int HALFKP_FEATURES = KING_SQUARES * FEATURES_PER_KING; // 41024
+    constexpr int MAX_ACTIVE = 30;                                  // Non-king pieces on a board
+    constexpr int HIDDEN = 256;                                     // Accumulator width per perspective
+    constexpr int FC1 = 32;
+    constexpr int FC2 = 32;
+
+    // Quantization: accumulator 1.0 is FT_SCALE, so the clipped accumulator is the u8 input of fc1
+    constexpr int FT_SCALE = 127;
+    constexpr int DENSE_K_ALIGN = 64;
+
+    constexpr int WHITE = 0;
+    constexpr int BLACK = 1;
+
+    constexpr int featureIndex(int king_square, int kind, int square)
+    {
+        return 1 + king_square * FEATURES_PER_KING + kind * 64 + square;
+    }
+
+    /**
+     * @brief Active features of a perspective.
+     * @param pieces WPawn, WKnight, WBishop, WRook, WQueen, WKing, then the same for black
+     * @return the number written to out (at most MAX_ACTIVE)
+     */
+    int activeFeatures(const std::uint64_t pieces[12], int perspective, std::uint32_t *out);
+
+    struct alignas(64) Accumulator
+    {
+        std::int16_t values[2][HIDDEN]; // [perspective][neuron]
+    };
+
+    // File: 64 byte header, feature transformer bias [HIDDEN] and weights [HALFKP_FEATURES][HIDDEN]
+    // (int16), fc1 and fc2 as int8 [out][k_padded] with float scales and biases, output layer floats
+    constexpr char FILE_MAGIC[8] = {'M', 'S', 'L', 'N', 'N', 'U', 'E', '1'};
+    constexpr std::size_t HEADER_BYTES = 64;
+
+    class Network
+    {
+    public:
+        Network() = default;
+        ~Network();
+        Network(const Network &) = delete;
+        Network &operator=(const Network &) = delete;
+
+        // Maps a network file written by NNUEHalfKPImpl::exportQuantized
+        bool load(const std::string &path);
+        bool loaded() const { return mapping != nullptr; }
+
+        // Recomputes one perspective of the accumulator from the pieces on the board
+        void refresh(Accumulator &accumulator, const std::uint64_t pieces[12], int perspective) const;
+
+        // Accumulator after a move from the one before it, pieces before and after the move
+        void update(const Accumulator &before, Accumulator &after,
+                    const std::uint64_t pieces_before[12], const std::uint64_t pieces_after[12]) const;
+
+        // Network output from the side to move's view, the same scale as NNUEHalfKPImpl::forward
+        float evaluate(const Accumulator &accumulator, bool white_to_move) const;
+
+    private:
+        struct Dense
+        {
+            int in = 0;
+            int out = 0;
+            int k_padded = 0;
+            const std::int8_t *weight = nullptr;
+            const float *scale = nullptr;
+            const float *bias = nullptr;
+        };
+
+        void *mapping = nullptr;
+        std::size_t mapped_bytes = 0;
+        const std::int16_t *ft_bias = nullptr;
+        const std::int16_t *ft_weight = nullptr;
+        Dense fc1, fc2;
+        const float *out_weight = nullptr;
+        const float *out_bias = nullptr;
+    };
+
+    // Byte size of the part of a network file after the header
+    std::size_t bodyBytes();
+}
+
+#endif // NNUE_INFERENCE_H
@@ -0,0 +1,69 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include <torch/torch.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chessnet.h"
+
+// Folded float forward pass in torch (the network the quantized one approximates)
+torch::Tensor foldedForward(const std::vector<FoldedLayer> &layers, torch::Tensor x);
+
+/**
+ * @brief Post-training int8 quantization of a folded network into an Int8Inference file.
+ *
+ * Weights get one symmetric scale per output channel (the largest weight of the channel maps
+ * to 127). The input of every layer gets an asymmetric 0..127 scale and zero point from the
+ * range it takes on the calibration batches (averaged over the batches, so rare outliers do
+ * not waste the resolution). Works for ChessNetConv, ChessNetConv2 and ChessNetLinear.
+ *
+ * @param calibration batches of model inputs (toTensor stacked), e.g. from load_data
+ */
+bool quantizeInt8(const std::vector<FoldedLayer> &layers, const std::vector<torch::Tensor> &calibration,
+                  const std::string &path, uint64_t fingerprint);
+
+// Writes an Int8Inference file of folded layers, the input of layer l ranging over [low[l], high[l]]
+bool writeInt8(const std::vector<FoldedLayer> &layers, const std::vector<double> &low, const std::vector<double> &high,
+               const std::string &path, uint64_t fingerprint);
+
+/**
+ * @brief Folded network with fake quantization, for quantization aware training.
+ *
+ * Starts from the folded layers of a trained network (ChessNetConv, ChessNetConv2 or
+ * ChessNetLinear): BatchNorm is merged into the weights Int8Inference rounds, so the int8 grid
+ * is the one of the folded weights, not of the layers of the network. forward quantizes every weight and every layer input the way
+ * Int8Inference does, with straight-through gradients, so fine-tuning finds weights that
+ * keep their accuracy in int8. In training mode the input range of every layer follows the
+ * batches (moving average of the batch minimum and maximum); exportInt8 writes those ranges.
+ */
+class QATNetImpl : public torch::nn::Module
+{
+public:
+    explicit QATNetImpl(const std::vector<FoldedLayer> &layers);
+
+    // Fake quantized forward pass, what the int8 kernel computes
+    torch::Tensor forward(torch::Tensor x);
+
+    // The same weights in float
+    torch::Tensor forwardFloat(torch::Tensor x);
+
+    // Current weights as folded layers
+    std::vector<FoldedLayer> layers();
+
+    // Writes the Int8Inference file the engine loads, tagged with the fingerprint of the source model
+    bool exportInt8(const std::string &path, uint64_t fingerprint);
+
+private:
+    torch::Tensor run(torch::Tensor x, bool quantize);
+
+    std::vector<FoldedLayer::Kind> kinds;
+    std::vector<bool> relus;
+    std::vector<torch::Tensor> weights, biases;
+    torch::Tensor input_low, input_high; // [layers], moving averages
+    torch::Tensor observed;              // Batches seen in training mode
+};
+
+TORCH_MODULE(QATNet);
+
+#endif // QUANTIZATION_H
@@ -0,0 +1,208 @@
+#include <torch/torch.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/chessnet.h"
+
+//-------------------------------------------------
+// Inference benchmark of the networks: latency (p50, p99) and positions per second of
+// toTensor, toBatch and forward for every model, batch size and intra-op thread count.
+// Results go to the console and, one row per measurement, to a CSV file for tracking
+// regressions between commits:  ./benchmark [results.csv]
+//-------------------------------------------------
+const std::vector<int64_t> BATCH_SIZES = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+const int WARMUP_ITERATIONS = 3;
+const int MIN_ITERATIONS = 5;
+const int MAX_ITERATIONS = 200;
+const double SECONDS_PER_MEASUREMENT = 2.0; // Stop after this long once MIN_ITERATIONS ran
+
+struct Measurement
+{
+    double p50_us;
+    double p99_us;
+    double positions_per_second;
+    int iterations;
+};
+
+// Random positions with both kings and up to 30 other pieces, already seen by the side to move
+std::vector<ChessPosition> random_positions(std::size_t count, std::mt19937_64 &rng)
+{
+    std::vector<ChessPosition> positions;
+    positions.reserve(count);
+    std::vector<int> squares(64);
+    for (int s = 0; s < 64; s++)
+    {
+        squares[s] = s;
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::shuffle(squares.begin(), squares.end(), rng);
+        uint64_t boards[12] = {};
+        boards[5] = 1ull << squares[0];  // WKing
+        boards[11] = 1ull << squares[1]; // BKing
+        const int others = 2 + static_cast<int>(rng() % 29);
+        for (int p = 0; p < others; p++)
+        {
+            const int square = squares[2 + p];
+            int type = static_cast<int>(rng() % 5);
+            if (type == 0 && (square < 8 || square >= 56))
+            {
+                type = 1; // No pawns on the first and last rank
+            }
+            boards[(rng() % 2) * 6 + type] |= 1ull << square;
+        }
+        positions.emplace_back(boards[0], boards[1], boards[2], boards[3], boards[4], boards[5],
+                               boards[6], boards[7], boards[8], boards[9], boards[10], boards[11],
+                               0, (rng() % 2) == 0,
+                               rng() % 2 == 0, rng() % 2 == 0, rng() % 2 == 0, rng() % 2 == 0);
+    }
+    return positions;
+}
+
+// Times run() until MAX_ITERATIONS or SECONDS_PER_MEASUREMENT, each call on its own
+template <class Run>
+Measurement measure(int64_t batch, Run &&run)
+{
+    for (int i = 0; i < WARMUP_ITERATIONS; i++)
+    {
+        run();
+    }
+
+    std::vector<double> samples;
+    const auto begin = std::chrono::steady_clock::now();
+    while (static_cast<int>(samples.size()) < MAX_ITERATIONS)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        if (static_cast<int>(samples.size()) >= MIN_ITERATIONS &&
+            std::chrono::duration<double>(end - begin).count() > SECONDS_PER_MEASUREMENT)
+        {
+            break;
+        }
+    }
+
+    double total = 0.0;
+    for (double sample : samples)
+    {
+        total += sample;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p)
+    {
+        return samples[std::min(samples.size() - 1, static_cast<std::size_t>(p * samples.size()))];
+    };
+    return {percentile(0.50), percentile(0.99), batch * samples.size() * 1e6 / total, static_cast<int>(samples.size())};
+}
+
+template <class Net>
+void benchmark_model(const std::string &name, torch::Device device, const std::vector<int> &thread_counts,
+                     const std::vector<ChessPosition> &positions, std::ofstream &csv)
+{
+    Net net;
+    net->to(device);
+    net->eval();
+
+    for (int threads : thread_counts)
+    {
+        torch::set_num_threads(threads);
+        for (int64_t batch : BATCH_SIZES)
+        {
+            const std::vector<ChessPosition> sample(positions.begin(), positions.begin() + batch);
+
+            // toTensor: one position at a time and stacked, as the engine builds its inputs
+            Measurement to_tensor = measure(batch, [&]
+                                            {
+                                                std::vector<torch::Tensor> inputs;
+                                                inputs.reserve(sample.size());
+                                                for (const auto &position : sample)
+                                                {
+                                                    inputs.push_back(net->toTensor(position));
+                                                }
+                                                return torch::stack(inputs); });
+
+            // toBatch: the whole batch encoded into one tensor, as load_data builds it
+            Measurement to_batch = measure(batch, [&]
+                                           { return toBatch(net, sample); });
+
+            // forward: input already on the device, reading the output back waits for it
+            const torch::Tensor input = toBatch(net, sample).to(device);
+            Measurement forward = measure(batch, [&]
+                                          {
+                                              c10::InferenceMode inference;
+                                              return net->forward(input).cpu(); });
+
+            const std::pair<const char *, Measurement> stages[] = {
+                {"toTensor", to_tensor}, {"toBatch", to_batch}, {"forward", forward}};
+            for (const auto &[stage, m] : stages)
+            {
+                csv << name << "," << (device.is_cuda() ? "cuda" : "cpu") << "," << threads << "," << batch << ","
+                    << stage << "," << m.iterations << "," << m.p50_us << "," << m.p99_us << ","
+                    << m.positions_per_second << "\n";
+            }
+            csv.flush();
+
+            std::cout << name << "  threads " << threads << "  batch " << batch
+                      << "  toTensor p50 " << to_tensor.p50_us << " us"
+                      << "  toBatch p50 " << to_batch.p50_us << " us"
+                      << "  forward p50 " << forward.p50_us << " us, p99 " << forward.p99_us << " us, "
+                      << forward.positions_per_second << " pos/s" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    torch::Device device(torch::kCPU);
+    if (torch::cuda::is_available())
+    {
+        device = torch::Device(torch::kCUDA);
+        std::cout << "CUDA is available! Using GPU." << std::endl;
+    }
+    else
+    {
+        std::cout << "CUDA is not available. Using CPU." << std::endl;
+    }
+
+    // 1, 2, 4, ... up to the hardware threads (intra-op threads only matter on the CPU)
+    std::vector<int> thread_counts;
+    const int hardware = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 1; threads < hardware; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(hardware);
+    if (device.is_cuda())
+    {
+        thread_counts = {1};
+    }
+
+    const std::string path = argc > 1 ? argv[1] : "benchmark_results.csv";
+    std::ofstream csv(path);
+    if (!csv)
+    {
+        std::cerr << "Can't write " << path << std::endl;
+        return 1;
+    }
+    csv << "model,device,threads,batch,stage,iterations,p50_us,p99_us,positions_per_second\n";
+
+    torch::manual_seed(0);
+    std::mt19937_64 rng(0);
+    const std::vector<ChessPosition> positions = random_positions(BATCH_SIZES.back(), rng);
+
+    // Randomly initialised weights, the cost of a forward pass does not depend on them
+    benchmark_model<ChessNetConv>("ChessNetConv", device, thread_counts, positions, csv);
+    benchmark_model<ChessNetConv2>("ChessNetConv2", device, thread_counts, positions, csv);
+    benchmark_model<ChessNetLinear>("ChessNetLinear", device, thread_counts, positions, csv);
+    benchmark_model<NNUEHalfKP>("NNUEHalfKP", device, thread_counts, positions, csv);
+
+    std::cout << "Results written to " << path << std::endl;
+    return 0;
+}
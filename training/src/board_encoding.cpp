@@ -0,0 +1,59 @@
+#include "../include/board_encoding.h"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace BoardEncoding
+{
+#if defined(__AVX512F__)
+    void expand(std::uint64_t bits, float value, float *squares)
+    {
+        const __m512 v = _mm512_set1_ps(value);
+        for (int i = 0; i < SQUARES; i += 16)
+        {
+            _mm512_storeu_ps(squares + i, _mm512_maskz_mov_ps(static_cast<__mmask16>(bits >> i), v));
+        }
+    }
+#elif defined(__AVX2__)
+    void expand(std::uint64_t bits, float value, float *squares)
+    {
+        const __m256i select = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256 v = _mm256_set1_ps(value);
+        for (int i = 0; i < SQUARES; i += 8)
+        {
+            // Lane j is set when bit j of this byte is
+            const __m256i byte = _mm256_set1_epi32(static_cast<int>((bits >> i) & 0xff));
+            const __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(byte, select), select);
+            _mm256_storeu_ps(squares + i, _mm256_and_ps(_mm256_castsi256_ps(set), v));
+        }
+    }
+#else
+    void expand(std::uint64_t bits, float value, float *squares)
+    {
+        for (int i = 0; i < SQUARES; i++)
+        {
+            squares[i] = ((bits >> i) & 1) ? value : 0.0f;
+        }
+    }
+#endif
+
+    void planes(const std::uint64_t bitboards[BITBOARDS], float *planes)
+    {
+        for (int p = 0; p < BITBOARDS; p++)
+        {
+            expand(bitboards[p], PLANE_VALUES[p], planes + p * SQUARES);
+        }
+    }
+
+    void features(const std::uint64_t bitboards[BITBOARDS], const bool flags[5], float *features)
+    {
+        for (int p = 0; p < BITBOARDS; p++)
+        {
+            expand(bitboards[p], (p >= 6 && p < 12) ? -1.0f : 1.0f, features + p * SQUARES);
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            features[BITBOARDS * SQUARES + i] = flags[i] ? 1.0f : 0.0f;
+        }
+    }
+}
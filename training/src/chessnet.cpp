@@ -1,5 +1,12 @@
 #include "../include/chessnet.h"
+#include "../include/board_encoding.h"
+#include "../include/conv_inference.h"
+#include "../include/nnue_inference.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <type_traits>
 
 std::vector<std::vector<int>> intToBitboard(uint64_t bitboard, int value)
 {
@@ -15,6 +22,26 @@ std::vector<std::vector<int>> intToBitboard(uint64_t bitboard, int value)
     return board;
 }
 
+// The 12 piece bitboards (own pieces first) and the en passant bitboard, BoardEncoding order
+static void positionBitboards(const ChessPosition &position, uint64_t bitboards[BoardEncoding::BITBOARDS])
+{
+    const uint64_t all[BoardEncoding::BITBOARDS] = {
+        position.WPawn, position.WKnight, position.WBishop, position.WRook, position.WQueen, position.WKing,
+        position.BPawn, position.BKnight, position.BBishop, position.BRook, position.BQueen, position.BKing,
+        position.EnPassant};
+    std::memcpy(bitboards, all, sizeof(all));
+}
+
+// Castling rights and side to move, the last five ChessNetLinear features
+static void positionFlags(const ChessPosition &position, bool flags[5])
+{
+    flags[0] = position.MyCastleL;
+    flags[1] = position.MyCastleR;
+    flags[2] = position.EnemyCastleL;
+    flags[3] = position.EnemyCastleR;
+    flags[4] = position.WhiteMove;
+}
+
 uint64_t flipVertical(uint64_t board, bool isWhite)
 {
     if (isWhite)
@@ -135,8 +162,8 @@ torch::Tensor ChessNetConvImpl::forward(torch::Tensor x)
     x = torch::tanh(fc3_bn(fc3(x)));
     // x = fc3_bn(fc3(x));
 
-    // Debug: if batch is large, print stats
-    if (x.size(0) > 100)
+    // Debug: if batch is large, print stats (training only, reading them back stalls inference)
+    if (is_training() && x.size(0) > 100)
     {
         std::cout << "output avg: " << x.mean().item().toFloat() << std::endl;
         std::cout << "output range: " << x.min().item().toFloat()
@@ -187,48 +214,105 @@ void ChessNetConvImpl::initialize_weights()
 
 torch::Tensor ChessNetConvImpl::toTensor(const ChessPosition &position)
 {
+    // Float32 tensor of shape [13, 8, 8], the planes are written straight into its storage
+    torch::Tensor tensor = torch::empty({BoardEncoding::BITBOARDS, 8, 8}, torch::kFloat32);
+    uint64_t bitboards[BoardEncoding::BITBOARDS];
+    positionBitboards(position, bitboards);
+    BoardEncoding::planes(bitboards, tensor.data_ptr<float>());
+    return tensor;
+}
 
-    // Convert each 64-bit bitboard into an 8x8 2D vector of ints
-    auto wPawn = intToBitboard(position.WPawn, 1);
-    auto wKnight = intToBitboard(position.WKnight, 3);
-    auto wBishop = intToBitboard(position.WBishop, 3);
-    auto wRook = intToBitboard(position.WRook, 5);
-    auto wQueen = intToBitboard(position.WQueen, 9);
-    auto wKing = intToBitboard(position.WKing, 10);
-
-    auto bPawn = intToBitboard(position.BPawn, -1);
-    auto bKnight = intToBitboard(position.BKnight, -3);
-    auto bBishop = intToBitboard(position.BBishop, -3);
-    auto bRook = intToBitboard(position.BRook, -5);
-    auto bQueen = intToBitboard(position.BQueen, -9);
-    auto bKing = intToBitboard(position.BKing, -10);
-
-    auto enPassant = intToBitboard(position.EnPassant, 1); // neutral => 0 or 1
-
-    // We collect them into a single container for easier iteration
-    // Each element is an 8x8 matrix (std::vector<std::vector<int>>)
-    std::vector<std::vector<std::vector<int>>> allBoards = {
-        wPawn, wKnight, wBishop, wRook, wQueen, wKing,
-        bPawn, bKnight, bBishop, bRook, bQueen, bKing,
-        enPassant};
-
-    // Create a float32 tensor of shape [13, 8, 8]
-    auto channels = static_cast<int>(allBoards.size()); // should be 13
-    torch::Tensor tensor = torch::empty({channels, 8, 8}, torch::kFloat32);
-    auto accessor = tensor.accessor<float, 3>();
-
-    // Copy data from each 8×8 board into the tensor
-    for (int c = 0; c < channels; ++c)
+uint64_t weightsFingerprint(torch::nn::Module &module)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const torch::Tensor &tensor)
     {
-        for (int row = 0; row < 8; ++row)
+        torch::Tensor data = tensor.detach().to(torch::kCPU).contiguous();
+        const auto *bytes = static_cast<const unsigned char *>(data.data_ptr());
+        for (size_t i = 0; i < data.nbytes(); i++)
         {
-            for (int col = 0; col < 8; ++col)
-            {
-                accessor[c][row][col] = static_cast<float>(allBoards[c][row][col]);
-            }
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
         }
+    };
+    for (const auto &parameter : module.parameters())
+    {
+        mix(parameter);
     }
-    return tensor;
+    for (const auto &buffer : module.buffers())
+    {
+        mix(buffer);
+    }
+    return hash;
+}
+
+// ------------------------------------------
+// BatchNorm folding
+// ------------------------------------------
+
+// Eval mode BatchNorm is y = scale * x + shift
+template <class BatchNorm>
+static std::pair<torch::Tensor, torch::Tensor> batchNormAffine(BatchNorm &bn)
+{
+    auto scale = bn->weight / torch::sqrt(bn->running_var + bn->options.eps());
+    return std::make_pair(scale, bn->bias - bn->running_mean * scale);
+}
+
+static FoldedLayer foldConv(torch::nn::Conv2d &conv, torch::nn::BatchNorm2d &bn)
+{
+    auto [scale, shift] = batchNormAffine(bn);
+    return {FoldedLayer::Conv3x3, conv->weight * scale.view({-1, 1, 1, 1}), conv->bias * scale + shift, true};
+}
+
+static FoldedLayer foldLinear(const torch::Tensor &weight, const torch::Tensor &bias, torch::nn::BatchNorm1d &bn, bool relu)
+{
+    auto [scale, shift] = batchNormAffine(bn);
+    return {FoldedLayer::Linear, weight * scale.view({-1, 1}), bias * scale + shift, relu};
+}
+
+// BatchNorm in front of a linear layer: W (a x + c) + b = (W a) x + (W c + b)
+static FoldedLayer foldInputAndLinear(torch::nn::BatchNorm1d &input_bn, torch::nn::Linear &fc, torch::nn::BatchNorm1d &bn)
+{
+    auto [scale, shift] = batchNormAffine(input_bn);
+    return foldLinear(fc->weight * scale.view({1, -1}), torch::mv(fc->weight, shift) + fc->bias, bn, true);
+}
+
+std::vector<FoldedLayer> ChessNetConvImpl::foldedLayers()
+{
+    torch::NoGradGuard no_grad;
+    return {foldConv(conv1, bn1),
+            foldConv(conv2, bn2),
+            foldConv(conv3, bn3),
+            foldConv(conv4, bn4),
+            foldInputAndLinear(conv_flat_bn, fc1, fc1_bn),
+            foldLinear(fc2->weight, fc2->bias, fc2_bn, true),
+            foldLinear(fc3->weight, fc3->bias, fc3_bn, false)};
+}
+
+bool ChessNetConvImpl::exportFolded(const std::string &path, uint64_t fingerprint)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Error: cannot write folded weights " << path << std::endl;
+        return false;
+    }
+    char header[ConvInference::HEADER_BYTES] = {};
+    std::memcpy(header, ConvInference::FILE_MAGIC, sizeof(ConvInference::FILE_MAGIC));
+    std::memcpy(header + 8, &fingerprint, sizeof(fingerprint));
+    out.write(header, sizeof(header));
+
+    std::size_t written = 0;
+    for (auto &layer : foldedLayers())
+    {
+        for (auto *tensor : {&layer.weight, &layer.bias})
+        {
+            auto values = tensor->to(torch::kCPU, torch::kFloat32).contiguous();
+            out.write(reinterpret_cast<const char *>(values.data_ptr<float>()), values.numel() * sizeof(float));
+            written += values.numel();
+        }
+    }
+    return out.good() && written == ConvInference::TOTAL_FLOATS;
 }
 
 // ------------------------------------------
@@ -306,6 +390,14 @@ void ChessNetLinearImpl::initialize_weights()
     }
 }
 
+std::vector<FoldedLayer> ChessNetLinearImpl::foldedLayers()
+{
+    torch::NoGradGuard no_grad;
+    return {foldLinear(fc1->weight, fc1->bias, bn1, true),
+            foldLinear(fc2->weight, fc2->bias, bn2, true),
+            foldLinear(fc3->weight, fc3->bias, bn3, false)};
+}
+
 std::vector<int> ChessNetLinearImpl::loadBitboard(uint64_t bitboard, bool isEnemy)
 {
     // "my" pieces set as 1, enemy pieces set as -1
@@ -323,60 +415,13 @@ std::vector<int> ChessNetLinearImpl::loadBitboard(uint64_t bitboard, bool isEnem
 
 torch::Tensor ChessNetLinearImpl::toTensor(const ChessPosition &position)
 {
-    std::vector<int> bitboards(837, 0);
-    int offset = 0;
+    uint64_t bitboards[BoardEncoding::BITBOARDS];
+    bool flags[5];
+    positionBitboards(position, bitboards);
+    positionFlags(position, flags);
 
-    // Helper lambda to process each bitboard field
-    auto process = [&](uint64_t bb, bool isEnemy)
-    {
-        std::vector<int> flat = loadBitboard(bb, isEnemy);
-        if (flat.size() != 64)
-        {
-            throw std::runtime_error("Error: Flattened bitboard size is not 64.");
-        }
-        std::copy(flat.begin(), flat.end(), bitboards.begin() + offset);
-        offset += 64;
-    };
-
-    // Process "my"
-    process(position.WPawn,false);
-    process(position.WKnight,false);
-    process(position.WBishop,false);
-    process(position.WRook,false);
-    process(position.WQueen,false);
-    process(position.WKing,false);
-
-    // Process enemy pieces
-    process(position.BPawn, true);
-    process(position.BKnight, true);
-    process(position.BBishop, true);
-    process(position.BRook, true);
-    process(position.BQueen, true);
-    process(position.BKing, true);
-
-    // Process en passant; assume en passant squares are neutral (not enemy)
-    process(position.EnPassant, false);
-
-    // Add castling rights and WhiteMove as final five entries
-    bitboards[832] = position.MyCastleL ? 1 : 0;
-    bitboards[833] = position.MyCastleR ? 1 : 0;
-    bitboards[834] = position.EnemyCastleL ? 1 : 0;
-    bitboards[835] = position.EnemyCastleR ? 1 : 0;
-    bitboards[836] = position.WhiteMove ? 1 : 0;
-
-    // Must have 837 elements
-    if (bitboards.size() != 837)
-    {
-        throw std::runtime_error("ChessNetLinear::toTensor: input vector must have exactly 837 elements!");
-    }
-
-    torch::Tensor tensor = torch::empty({837}, torch::kFloat32);
-    auto accessor = tensor.accessor<float, 1>();
-
-    for (int i = 0; i < 837; i++)
-    {
-        accessor[i] = static_cast<float>(bitboards[i]);
-    }
+    torch::Tensor tensor = torch::empty({BoardEncoding::FEATURES_SIZE}, torch::kFloat32);
+    BoardEncoding::features(bitboards, flags, tensor.data_ptr<float>());
 
     // shape: [837]
     if (torch::cuda::is_available())
@@ -389,17 +434,9 @@ torch::Tensor ChessNetLinearImpl::toTensor(const ChessPosition &position)
 uint32_t calculateHalfKPIndex(uint64_t kingSquare, uint64_t pieceSquare,
                               PieceType pieceType, bool isWhite)
 {
-    // Map the piece type to the correct range for White or Black
-    // 6 piece types for White, 6 for Black
-    uint32_t pieceOffset = isWhite ? 0 : 6;
-
-    // Calculate the relative square of the piece to the king
-    // (Example logic; adapt if your board representation differs)
-    uint32_t relativeSquare = static_cast<uint32_t>(pieceSquare - kingSquare);
-
-    // Combine king square, piece type, and relative square into a feature index
-    // The factor "64 * 10" is just an example; ensure it matches your indexing
-    return (static_cast<uint32_t>(kingSquare) * 64 * 10) + (relativeSquare * 10) + (pieceOffset + static_cast<uint32_t>(pieceType));
+    // Own pawn..queen are kinds 0-4, the opponent's 5-9; kings are not features
+    uint32_t kind = static_cast<uint32_t>(pieceType) + (isWhite ? 0 : 5);
+    return NNUEInference::featureIndex(static_cast<int>(kingSquare), static_cast<int>(kind), static_cast<int>(pieceSquare));
 }
 
 // ------------------------------------------------------------
@@ -407,20 +444,33 @@ uint32_t calculateHalfKPIndex(uint64_t kingSquare, uint64_t pieceSquare,
 // ------------------------------------------------------------
 NNUEHalfKPImpl::NNUEHalfKPImpl()
 {
-    // Example "hard-coded" defaults
-    int defaultInput = 41024; // e.g., 64 squares * piece types, etc.
-    int defaultHidden = 256;
-    int defaultOutput = 1;
+    ft = register_module("ft", torch::nn::EmbeddingBag(
+                                   torch::nn::EmbeddingBagOptions(NNUEInference::HALFKP_FEATURES, NNUEInference::HIDDEN)
+                                       .mode(torch::kSum)
+                                       .padding_idx(0)));
+    ft_bias = register_parameter("ft_bias", torch::zeros({NNUEInference::HIDDEN}));
+    fc1 = register_module("fc1", torch::nn::Linear(2 * NNUEInference::HIDDEN, NNUEInference::FC1));
+    fc2 = register_module("fc2", torch::nn::Linear(NNUEInference::FC1, NNUEInference::FC2));
+    fc3 = register_module("fc3", torch::nn::Linear(NNUEInference::FC2, 1));
 
-    fc1 = register_module("fc1", torch::nn::Linear(defaultInput, defaultHidden));
-    fc2 = register_module("fc2", torch::nn::Linear(defaultHidden, defaultHidden));
-    fc3 = register_module("fc3", torch::nn::Linear(defaultHidden, defaultOutput));
+    initialize_weights();
+}
 
-    bn1 = register_module("bn1", torch::nn::BatchNorm1d(defaultHidden));
-    bn2 = register_module("bn2", torch::nn::BatchNorm1d(defaultHidden));
-    bn3 = register_module("bn3", torch::nn::BatchNorm1d(defaultOutput));
+void NNUEHalfKPImpl::save(torch::serialize::OutputArchive &archive) const
+{
+    torch::nn::Module::save(archive);
+    archive.write("architecture_version", torch::tensor(ARCHITECTURE_VERSION, torch::kInt64), /*is_buffer=*/true);
+}
 
-    initialize_weights();
+void NNUEHalfKPImpl::load(torch::serialize::InputArchive &archive)
+{
+    torch::Tensor version;
+    const bool versioned = archive.try_read("architecture_version", version, /*is_buffer=*/true);
+    TORCH_CHECK(versioned && version.item<int64_t>() == ARCHITECTURE_VERSION,
+                "NNUEHalfKP checkpoint of architecture version ", versioned ? version.item<int64_t>() : 1,
+                ", this build needs version ", ARCHITECTURE_VERSION,
+                " (EmbeddingBag feature transformer, no BatchNorms): retrain or distill the network again");
+    torch::nn::Module::load(archive);
 }
 
 // ------------------------------------------------------------
@@ -428,30 +478,23 @@ NNUEHalfKPImpl::NNUEHalfKPImpl()
 // ------------------------------------------------------------
 torch::Tensor NNUEHalfKPImpl::forward(torch::Tensor x)
 {
-    // If shape is [inputSize], unsqueeze to [1, inputSize]
-    if (x.dim() == 1)
+    // If shape is [2, MAX_ACTIVE], unsqueeze to [1, 2, MAX_ACTIVE]
+    if (x.dim() == 2)
     {
         x = x.unsqueeze(0);
     }
+    const int64_t batch = x.size(0);
 
-    // std::cout << x[0] << std::endl;
-
-    // fc1 -> bn1 -> relu
-    x = fc1->forward(x);
-    x = bn1->forward(x);
-    x = torch::relu(x);
-
-    // fc2 -> bn2 -> relu
-    x = fc2->forward(x);
-    x = bn2->forward(x);
-    x = torch::relu(x);
+    // Both perspectives through the same transformer, one bag per perspective, side to move first.
+    // Clipped ReLU everywhere: the engine keeps these values in 0..127
+    x = ft->forward(x.reshape({batch * 2, NNUEInference::MAX_ACTIVE}).to(torch::kLong)) + ft_bias;
+    x = torch::clamp(x, 0.0, 1.0).reshape({batch, 2 * NNUEInference::HIDDEN});
 
-    // fc3 -> bn3 -> tanh
-    x = fc3->forward(x);
-    x = bn3->forward(x);
-    x = torch::tanh(x);
+    x = torch::clamp(fc1->forward(x), 0.0, 1.0);
+    x = torch::clamp(fc2->forward(x), 0.0, 1.0);
 
-    return x;
+    // Output in [-1, 1]
+    return torch::tanh(fc3->forward(x));
 }
 
 // ------------------------------------------------------------
@@ -459,6 +502,13 @@ torch::Tensor NNUEHalfKPImpl::forward(torch::Tensor x)
 // ------------------------------------------------------------
 void NNUEHalfKPImpl::initialize_weights()
 {
+    // The bound kaiming_uniform_ gives a Linear of HALFKP_FEATURES inputs, the padding row stays 0
+    torch::NoGradGuard no_grad;
+    const double bound = std::sqrt(6.0 / ((1.0 + 0.01 * 0.01) * NNUEInference::HALFKP_FEATURES));
+    torch::nn::init::uniform_(ft->weight, -bound, bound);
+    ft->weight[0].zero_();
+    torch::nn::init::constant_(ft_bias, 0.01);
+
     for (auto &module : modules(/*include_self=*/false))
     {
         // For each Linear layer
@@ -475,117 +525,95 @@ void NNUEHalfKPImpl::initialize_weights()
                 torch::nn::init::constant_(fc->bias, 0.01);
             }
         }
-        // For each BatchNorm1d layer
-        else if (auto *bn1d = dynamic_cast<torch::nn::BatchNorm1dImpl *>(module.get()))
-        {
-            torch::nn::init::ones_(bn1d->weight);
-            torch::nn::init::zeros_(bn1d->bias);
-        }
     }
 }
 
 // ------------------------------------------------------------
-// toTensor: Convert a ChessPosition to a dense tensor
+// toTensor: Convert a ChessPosition to the feature indices of both perspectives
 // ------------------------------------------------------------
 torch::Tensor NNUEHalfKPImpl::toTensor(const ChessPosition &position)
 {
-    // 1. Gather indices as int64_t directly.
-    std::vector<int64_t> featureIndices = createHalfKPInputVector(position);
-
-    // 2. Create a 1D int64 tensor from the data.
-    //    Use .clone() so that the tensor owns the memory
-    auto indices = torch::from_blob(
-        featureIndices.data(),
-        {static_cast<long>(featureIndices.size())},
-        torch::kInt64
-    ).clone();
-
-    // 3. Create the values tensor (float32) with the same length.
-    auto values = torch::ones(
-        {static_cast<long>(featureIndices.size())},
-        torch::TensorOptions().dtype(torch::kFloat32)
-    );
-
-    // 4. Build the sparse COO tensor.
-    //    - indices must have shape [1, N] or [2, N], so we do unsqueeze(0) 
-    //      to get [1, N].
-    auto sparseTensor = torch::sparse_coo_tensor(
-        indices.unsqueeze(0), // shape [1, N]
-        values,               // shape [N]
-        {41024}               // total size of the 1D feature space
-    );
-
-    // 5. Convert to dense.
-    auto denseTensor = sparseTensor.to_dense();
-
-    // 6. (Optional) move to GPU if available.
-    if (torch::cuda::is_available()) {
-        denseTensor = denseTensor.to(torch::kCUDA);
+    torch::Tensor tensor = torch::zeros({2, NNUEInference::MAX_ACTIVE}, torch::kInt64);
+    auto accessor = tensor.accessor<int64_t, 2>();
+    for (int perspective = NNUEInference::WHITE; perspective <= NNUEInference::BLACK; perspective++)
+    {
+        int slot = 0;
+        for (int64_t index : createHalfKPInputVector(position, perspective))
+        {
+            accessor[perspective][slot++] = index;
+        }
     }
-
-    // 7. Return your final dense tensor.
-    return denseTensor;
+    return tensor;
 }
 
-
-
 // ------------------------------------------------------------
 // createHalfKPInputVector: Gather feature indices
 // ------------------------------------------------------------
-std::vector<int64_t> NNUEHalfKPImpl::createHalfKPInputVector(const ChessPosition &position)
+std::vector<int64_t> NNUEHalfKPImpl::createHalfKPInputVector(const ChessPosition &position, int perspective)
+{
+    // The position is already seen by the side to move, so "white" is the side to move
+    const uint64_t pieces[12] = {
+        position.WPawn, position.WKnight, position.WBishop, position.WRook, position.WQueen, position.WKing,
+        position.BPawn, position.BKnight, position.BBishop, position.BRook, position.BQueen, position.BKing};
+
+    uint32_t features[NNUEInference::MAX_ACTIVE];
+    int count = NNUEInference::activeFeatures(pieces, perspective, features);
+    return std::vector<int64_t>(features, features + count);
+}
+
+// ------------------------------------------------------------
+// exportQuantized: NNUEInference file
+// ------------------------------------------------------------
+bool NNUEHalfKPImpl::exportQuantized(const std::string &path)
 {
-    // We ultimately want a std::vector<int64_t> to return
-    std::vector<int64_t> featureIndices;
-    featureIndices.reserve(256); // or whatever approximate upper bound you want
+    torch::NoGradGuard no_grad;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Error: cannot write NNUE network " << path << std::endl;
+        return false;
+    }
 
-    // Example usage of uint64_t for bitboards
-    uint64_t whiteKingSquare = __builtin_ctzll(position.WKing);
-    uint64_t blackKingSquare = __builtin_ctzll(position.BKing);
+    char header[NNUEInference::HEADER_BYTES] = {};
+    const uint32_t shape[4] = {NNUEInference::HALFKP_FEATURES, NNUEInference::HIDDEN, NNUEInference::FC1, NNUEInference::FC2};
+    std::memcpy(header, NNUEInference::FILE_MAGIC, sizeof(NNUEInference::FILE_MAGIC));
+    std::memcpy(header + 8, shape, sizeof(shape));
+    out.write(header, sizeof(header));
 
-    // Helper lambda to add features for a given side
-    auto addFeatures = [&](uint64_t kingSquare, const uint64_t *pieces, bool isWhite) {
-        for (int pieceType = PAWN; pieceType <= KING; ++pieceType)
-        {
-            uint64_t pieceBitboard = pieces[pieceType];
-            while (pieceBitboard)
-            {
-                uint64_t pieceSquare = __builtin_ctzll(pieceBitboard);
-                
-                // calculateHalfKPIndex returns uint32_t, 
-                // but we cast to int64_t before storing
-                int64_t idx = static_cast<int64_t>(calculateHalfKPIndex(
-                    kingSquare,
-                    pieceSquare,
-                    static_cast<PieceType>(pieceType),
-                    isWhite
-                ));
-                
-                featureIndices.push_back(idx);
-
-                // Clear the LSB
-                pieceBitboard &= (pieceBitboard - 1);
-            }
-        }
+    auto write = [&out](const torch::Tensor &tensor)
+    {
+        auto data = tensor.contiguous();
+        out.write(static_cast<const char *>(data.data_ptr()), data.nbytes());
     };
 
-    // Arrays of piece bitboards for White/Black
-    const uint64_t whitePieces[] = {
-        position.WPawn, position.WKnight, position.WBishop,
-        position.WRook, position.WQueen, position.WKing
-    };
-    const uint64_t blackPieces[] = {
-        position.BPawn, position.BKnight, position.BBishop,
-        position.BRook, position.BQueen, position.BKing
+    // Feature transformer: int16 with 1.0 = FT_SCALE, one column of HIDDEN values per feature
+    auto ft_scaled = [](const torch::Tensor &tensor)
+    {
+        return torch::round(tensor.to(torch::kCPU, torch::kFloat32) * NNUEInference::FT_SCALE).clamp(-32767, 32767).to(torch::kInt16);
     };
+    write(ft_scaled(ft_bias));
+    write(ft_scaled(ft->weight));
 
-    // Add features for White
-    addFeatures(whiteKingSquare, whitePieces, true);
-
-    // Add features for Black
-    addFeatures(blackKingSquare, blackPieces, false);
+    // Dense layers: int8 rows padded to DENSE_K_ALIGN, one scale per output
+    auto dense = [&write](torch::nn::Linear &layer)
+    {
+        torch::Tensor weight = layer->weight.to(torch::kCPU, torch::kFloat32);
+        const int64_t k = weight.size(1);
+        const int64_t k_padded = (k + NNUEInference::DENSE_K_ALIGN - 1) / NNUEInference::DENSE_K_ALIGN * NNUEInference::DENSE_K_ALIGN;
+        torch::Tensor scale = std::get<0>(weight.abs().max(1)) / 127.0f;
+        scale = torch::where(scale > 0, scale, torch::ones_like(scale));
+        torch::Tensor quantized = torch::zeros({weight.size(0), k_padded}, torch::kInt8);
+        quantized.narrow(1, 0, k).copy_(torch::round(weight / scale.unsqueeze(1)).clamp(-127, 127).to(torch::kInt8));
+        write(quantized);
+        write(scale);
+        write(layer->bias.to(torch::kCPU, torch::kFloat32));
+    };
+    dense(fc1);
+    dense(fc2);
 
-    // Return the int64_t vector
-    return featureIndices;
+    write(fc3->weight.to(torch::kCPU, torch::kFloat32));
+    write(fc3->bias.to(torch::kCPU, torch::kFloat32));
+    return out.good();
 }
 
 
@@ -651,8 +679,8 @@ torch::Tensor ChessNetConv2Impl::forward(torch::Tensor x)
     x = torch::tanh(fc3_bn(fc3(x)));
     // x = fc3_bn(fc3(x));
 
-    // Debug: if batch is large, print stats
-    if (x.size(0) > 100)
+    // Debug: if batch is large, print stats (training only, reading them back stalls inference)
+    if (is_training() && x.size(0) > 100)
     {
         std::cout << "output avg: " << x.mean().item().toFloat() << std::endl;
         std::cout << "output range: " << x.min().item().toFloat()
@@ -662,6 +690,16 @@ torch::Tensor ChessNetConv2Impl::forward(torch::Tensor x)
     return x;
 }
 
+std::vector<FoldedLayer> ChessNetConv2Impl::foldedLayers()
+{
+    torch::NoGradGuard no_grad;
+    return {foldConv(conv1, bn1),
+            foldConv(conv2, bn2),
+            foldInputAndLinear(conv_flat_bn, fc1, fc1_bn),
+            foldLinear(fc2->weight, fc2->bias, fc2_bn, true),
+            foldLinear(fc3->weight, fc3->bias, fc3_bn, false)};
+}
+
 void ChessNetConv2Impl::initialize_weights()
 {
     for (auto &module : modules(/*include_self=*/false))
@@ -703,46 +741,59 @@ void ChessNetConv2Impl::initialize_weights()
 
 torch::Tensor ChessNetConv2Impl::toTensor(const ChessPosition &position)
 {
+    // Float32 tensor of shape [13, 8, 8], the planes are written straight into its storage
+    torch::Tensor tensor = torch::empty({BoardEncoding::BITBOARDS, 8, 8}, torch::kFloat32);
+    uint64_t bitboards[BoardEncoding::BITBOARDS];
+    positionBitboards(position, bitboards);
+    BoardEncoding::planes(bitboards, tensor.data_ptr<float>());
+    return tensor;
+}
 
-    // Convert each 64-bit bitboard into an 8x8 2D vector of ints
-    auto wPawn = intToBitboard(position.WPawn, 1);
-    auto wKnight = intToBitboard(position.WKnight, 3);
-    auto wBishop = intToBitboard(position.WBishop, 3);
-    auto wRook = intToBitboard(position.WRook, 5);
-    auto wQueen = intToBitboard(position.WQueen, 9);
-    auto wKing = intToBitboard(position.WKing, 10);
-
-    auto bPawn = intToBitboard(position.BPawn, -1);
-    auto bKnight = intToBitboard(position.BKnight, -3);
-    auto bBishop = intToBitboard(position.BBishop, -3);
-    auto bRook = intToBitboard(position.BRook, -5);
-    auto bQueen = intToBitboard(position.BQueen, -9);
-    auto bKing = intToBitboard(position.BKing, -10);
-
-    auto enPassant = intToBitboard(position.EnPassant, 1); // neutral => 0 or 1
-
-    // We collect them into a single container for easier iteration
-    // Each element is an 8x8 matrix (std::vector<std::vector<int>>)
-    std::vector<std::vector<std::vector<int>>> allBoards = {
-        wPawn, wKnight, wBishop, wRook, wQueen, wKing,
-        bPawn, bKnight, bBishop, bRook, bQueen, bKing,
-        enPassant};
-
-    // Create a float32 tensor of shape [13, 8, 8]
-    auto channels = static_cast<int>(allBoards.size()); // should be 13
-    torch::Tensor tensor = torch::empty({channels, 8, 8}, torch::kFloat32);
-    auto accessor = tensor.accessor<float, 3>();
-
-    // Copy data from each 8×8 board into the tensor
-    for (int c = 0; c < channels; ++c)
+template <class Net>
+torch::Tensor toBatch(Net &net, const std::vector<ChessPosition> &positions)
+{
+    const int64_t count = static_cast<int64_t>(positions.size());
+    uint64_t bitboards[BoardEncoding::BITBOARDS];
+    if constexpr (std::is_same_v<Net, ChessNetConv> || std::is_same_v<Net, ChessNetConv2>)
     {
-        for (int row = 0; row < 8; ++row)
+        torch::Tensor batch = torch::empty({count, BoardEncoding::BITBOARDS, 8, 8}, torch::kFloat32);
+        float *out = batch.data_ptr<float>();
+        for (const auto &position : positions)
         {
-            for (int col = 0; col < 8; ++col)
-            {
-                accessor[c][row][col] = static_cast<float>(allBoards[c][row][col]);
-            }
+            positionBitboards(position, bitboards);
+            BoardEncoding::planes(bitboards, out);
+            out += BoardEncoding::PLANES_SIZE;
         }
+        return batch;
     }
-    return tensor;
-}
\ No newline at end of file
+    else if constexpr (std::is_same_v<Net, ChessNetLinear>)
+    {
+        torch::Tensor batch = torch::empty({count, BoardEncoding::FEATURES_SIZE}, torch::kFloat32);
+        float *out = batch.data_ptr<float>();
+        bool flags[5];
+        for (const auto &position : positions)
+        {
+            positionBitboards(position, bitboards);
+            positionFlags(position, flags);
+            BoardEncoding::features(bitboards, flags, out);
+            out += BoardEncoding::FEATURES_SIZE;
+        }
+        return batch;
+    }
+    else
+    {
+        // Inputs that are not planes (NNUEHalfKP's feature indices) are small already
+        std::vector<torch::Tensor> inputs;
+        inputs.reserve(positions.size());
+        for (const auto &position : positions)
+        {
+            inputs.push_back(net->toTensor(position));
+        }
+        return torch::stack(inputs);
+    }
+}
+
+template torch::Tensor toBatch(ChessNetConv &, const std::vector<ChessPosition> &);
+template torch::Tensor toBatch(ChessNetConv2 &, const std::vector<ChessPosition> &);
+template torch::Tensor toBatch(ChessNetLinear &, const std::vector<ChessPosition> &);
+template torch::Tensor toBatch(NNUEHalfKP &, const std::vector<ChessPosition> &);
@@ -0,0 +1,412 @@
+#include "../include/conv_inference.h"
+#include "../include/board_encoding.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace ConvInference
+{
+    // ------------------------------------------
+    // SIMD vector of WIDTH floats, the widest the compiler targets
+    // ------------------------------------------
+#if defined(__AVX512F__)
+    using Vec = __m512;
+    constexpr int WIDTH = 16;
+    static inline Vec vload(const float *p) { return _mm512_loadu_ps(p); }
+    static inline void vstore(float *p, Vec v) { _mm512_storeu_ps(p, v); }
+    static inline Vec vset(float x) { return _mm512_set1_ps(x); }
+    static inline Vec vzero() { return _mm512_setzero_ps(); }
+    static inline Vec vfma(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+    static inline Vec vadd(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    static inline Vec vsub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    static inline Vec vrelu(Vec a) { return _mm512_max_ps(a, _mm512_setzero_ps()); }
+    static inline float vsum(Vec a) { return _mm512_reduce_add_ps(a); }
+#elif defined(__AVX2__) && defined(__FMA__)
+    using Vec = __m256;
+    constexpr int WIDTH = 8;
+    static inline Vec vload(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void vstore(float *p, Vec v) { _mm256_storeu_ps(p, v); }
+    static inline Vec vset(float x) { return _mm256_set1_ps(x); }
+    static inline Vec vzero() { return _mm256_setzero_ps(); }
+    static inline Vec vfma(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+    static inline Vec vadd(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    static inline Vec vsub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    static inline Vec vrelu(Vec a) { return _mm256_max_ps(a, _mm256_setzero_ps()); }
+    static inline float vsum(Vec a)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+#else
+    using Vec = float;
+    constexpr int WIDTH = 1;
+    static inline Vec vload(const float *p) { return *p; }
+    static inline void vstore(float *p, Vec v) { *p = v; }
+    static inline Vec vset(float x) { return x; }
+    static inline Vec vzero() { return 0.0f; }
+    static inline Vec vfma(Vec a, Vec b, Vec c) { return a * b + c; }
+    static inline Vec vadd(Vec a, Vec b) { return a + b; }
+    static inline Vec vsub(Vec a, Vec b) { return a - b; }
+    static inline Vec vrelu(Vec a) { return a > 0.0f ? a : 0.0f; }
+    static inline float vsum(Vec a) { return a; }
+#endif
+
+    // Squares handled per block of the convolution (one AVX-512 vector, two AVX2 vectors)
+    constexpr int SQUARE_BLOCK = 16;
+    constexpr int VECS = SQUARE_BLOCK / WIDTH;
+    // Output channels sharing one load of the input
+    constexpr int OUT_BLOCK = 4;
+
+    // ------------------------------------------
+    // 3x3 convolution, padding 1, on 8x8 planes, followed by ReLU
+    // ------------------------------------------
+
+    /**
+     * @brief Spreads the input into IN * 9 shifted planes (im2col): row i * 9 + tap holds the
+     *        input of plane i seen through kernel tap (ky, kx), zero where it falls off the board.
+     */
+    template <int IN>
+    static void shiftedPlanes(const float *in, float *shifted)
+    {
+        for (int i = 0; i < IN; i++)
+        {
+            const float *plane = in + i * SQUARES;
+            for (int tap = 0; tap < 9; tap++)
+            {
+                const int dy = tap / 3 - 1;
+                const int dx = tap % 3 - 1;
+                float *out = shifted + (i * 9 + tap) * SQUARES;
+                for (int row = 0; row < 8; row++)
+                {
+                    for (int col = 0; col < 8; col++)
+                    {
+                        const int r = row + dy;
+                        const int c = col + dx;
+                        out[row * 8 + col] = (r >= 0 && r < 8 && c >= 0 && c < 8) ? plane[r * 8 + c] : 0.0f;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief out[o] = relu(bias[o] + sum_k weight[o][k] * shifted[k]) over K = IN * 9 rows,
+     *        OUT_BLOCK output channels by SQUARE_BLOCK squares at a time so every input load
+     *        feeds OUT_BLOCK multiply-adds.
+     */
+    template <int IN, int OUT>
+    static void conv3x3(const float *weight, const float *bias, const float *shifted, float *out)
+    {
+        static_assert(OUT % OUT_BLOCK == 0, "output channels must be a multiple of OUT_BLOCK");
+        constexpr int K = IN * 9;
+
+        for (int o = 0; o < OUT; o += OUT_BLOCK)
+        {
+            for (int s = 0; s < SQUARES; s += SQUARE_BLOCK)
+            {
+                Vec acc[OUT_BLOCK][VECS];
+                for (int b = 0; b < OUT_BLOCK; b++)
+                {
+                    for (int v = 0; v < VECS; v++)
+                    {
+                        acc[b][v] = vset(bias[o + b]);
+                    }
+                }
+
+                const float *input = shifted + s;
+                for (int k = 0; k < K; k++, input += SQUARES)
+                {
+                    Vec x[VECS];
+                    for (int v = 0; v < VECS; v++)
+                    {
+                        x[v] = vload(input + v * WIDTH);
+                    }
+                    for (int b = 0; b < OUT_BLOCK; b++)
+                    {
+                        const Vec w = vset(weight[(o + b) * K + k]);
+                        for (int v = 0; v < VECS; v++)
+                        {
+                            acc[b][v] = vfma(w, x[v], acc[b][v]);
+                        }
+                    }
+                }
+
+                for (int b = 0; b < OUT_BLOCK; b++)
+                {
+                    for (int v = 0; v < VECS; v++)
+                    {
+                        vstore(out + (o + b) * SQUARES + s + v * WIDTH, vrelu(acc[b][v]));
+                    }
+                }
+            }
+        }
+    }
+
+    // ------------------------------------------
+    // Fully connected layers: blocked GEMV, four rows share each load of the input
+    // ------------------------------------------
+    constexpr int ROW_BLOCK = 4;
+
+    template <int IN, int OUT, bool RELU>
+    static void gemv(const float *weight, const float *bias, const float *in, float *out)
+    {
+        static_assert(IN % WIDTH == 0 && OUT % ROW_BLOCK == 0, "layer shape does not fit the blocking");
+        for (int o = 0; o < OUT; o += ROW_BLOCK)
+        {
+            Vec acc[ROW_BLOCK];
+            for (int r = 0; r < ROW_BLOCK; r++)
+            {
+                acc[r] = vzero();
+            }
+            for (int i = 0; i < IN; i += WIDTH)
+            {
+                const Vec x = vload(in + i);
+                for (int r = 0; r < ROW_BLOCK; r++)
+                {
+                    acc[r] = vfma(vload(weight + static_cast<std::size_t>(o + r) * IN + i), x, acc[r]);
+                }
+            }
+            for (int r = 0; r < ROW_BLOCK; r++)
+            {
+                const float value = vsum(acc[r]) + bias[o + r];
+                out[o + r] = RELU && value < 0.0f ? 0.0f : value;
+            }
+        }
+    }
+
+    // Single output (fc3)
+    template <int IN>
+    static float dot(const float *weight, const float *in)
+    {
+        Vec acc = vzero();
+        for (int i = 0; i < IN; i += WIDTH)
+        {
+            acc = vfma(vload(weight + i), vload(in + i), acc);
+        }
+        return vsum(acc);
+    }
+
+    // ------------------------------------------
+    // conv1 accumulator
+    // ------------------------------------------
+
+    /**
+     * @brief Adds (or removes) a piece on square of the plane whose CONV1 x 9 taps are given:
+     *        output square t reads t + (dy, dx) through tap (dy, dx), so the piece reaches
+     *        square - (dy, dx) through every tap that stays on the board.
+     */
+    template <bool ADD>
+    static inline void applyPiece(float *acc, const float *taps, int square)
+    {
+        const int row = square / 8, col = square % 8;
+        for (int tap = 0; tap < 9; tap++)
+        {
+            const int r = row - (tap / 3 - 1);
+            const int c = col - (tap % 3 - 1);
+            if (r < 0 || r >= 8 || c < 0 || c >= 8)
+            {
+                continue;
+            }
+            float *out = acc + (r * 8 + c) * CONV1;
+            const float *w = taps + tap * CONV1;
+            for (int ch = 0; ch < CONV1; ch += WIDTH)
+            {
+                vstore(out + ch, ADD ? vadd(vload(out + ch), vload(w + ch)) : vsub(vload(out + ch), vload(w + ch)));
+            }
+        }
+    }
+
+    // Input plane and square of board bitboard b (NNUEInference piece order) in a perspective
+    static inline int planeOf(int board, int perspective) { return perspective == WHITE ? board : (board + 6) % 12; }
+    static inline int flipOf(int perspective) { return perspective == WHITE ? 0 : 56; }
+
+    // ------------------------------------------
+    // Network
+    // ------------------------------------------
+    Network::~Network()
+    {
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mapped_bytes);
+        }
+    }
+
+    bool Network::load(const std::string &path, std::uint64_t fingerprint)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        const std::size_t bytes = HEADER_BYTES + TOTAL_FLOATS * sizeof(float);
+        struct stat st;
+        char magic[8];
+        std::uint64_t stored = 0;
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != bytes ||
+            pread(fd, magic, 8, 0) != 8 || pread(fd, &stored, 8, 8) != 8 ||
+            std::memcmp(magic, FILE_MAGIC, 8) != 0 || stored != fingerprint)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Error: failed to mmap folded weights " << path << std::endl;
+            return false;
+        }
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mapped_bytes);
+        }
+        mapping = map;
+        mapped_bytes = bytes;
+
+        const float *p = reinterpret_cast<const float *>(static_cast<const unsigned char *>(map) + HEADER_BYTES);
+        auto take = [&p](Layer &layer, std::size_t weights, std::size_t biases)
+        {
+            layer.weight = p;
+            layer.bias = p + weights;
+            p += weights + biases;
+        };
+        take(conv[0], static_cast<std::size_t>(CONV1) * INPUT_PLANES * 9, CONV1);
+        take(conv[1], static_cast<std::size_t>(CONV2) * CONV1 * 9, CONV2);
+        take(conv[2], static_cast<std::size_t>(CONV3) * CONV2 * 9, CONV3);
+        take(conv[3], static_cast<std::size_t>(CONV4) * CONV3 * 9, CONV4);
+        take(fc[0], static_cast<std::size_t>(FC1) * CONV4 * SQUARES, FC1);
+        take(fc[1], static_cast<std::size_t>(FC2) * FC1, FC2);
+        take(fc[2], FC2, 1);
+
+        conv1_taps.resize(static_cast<std::size_t>(INPUT_PLANES) * 9 * CONV1);
+        for (int p = 0; p < INPUT_PLANES; p++)
+        {
+            for (int tap = 0; tap < 9; tap++)
+            {
+                for (int ch = 0; ch < CONV1; ch++)
+                {
+                    conv1_taps[(p * 9 + tap) * CONV1 + ch] = BoardEncoding::PLANE_VALUES[p] * conv[0].weight[(ch * INPUT_PLANES + p) * 9 + tap];
+                }
+            }
+        }
+        return true;
+    }
+
+    // Per thread activations: the largest im2col input is conv4's, the largest activation conv4's output
+    struct Scratch
+    {
+        std::vector<float> shifted = std::vector<float>(static_cast<std::size_t>(CONV3) * 9 * SQUARES);
+        std::vector<float> a = std::vector<float>(static_cast<std::size_t>(CONV4) * SQUARES);
+        std::vector<float> b = std::vector<float>(static_cast<std::size_t>(CONV4) * SQUARES);
+    };
+
+    static Scratch &scratch()
+    {
+        thread_local Scratch buffers;
+        return buffers;
+    }
+
+    float Network::forward(const float *planes) const
+    {
+        Scratch &s = scratch();
+        shiftedPlanes<INPUT_PLANES>(planes, s.shifted.data());
+        conv3x3<INPUT_PLANES, CONV1>(conv[0].weight, conv[0].bias, s.shifted.data(), s.a.data());
+        return afterConv1(s.a.data(), s.b.data(), s.shifted.data());
+    }
+
+    float Network::afterConv1(float *a, float *b, float *shifted) const
+    {
+        shiftedPlanes<CONV1>(a, shifted);
+        conv3x3<CONV1, CONV2>(conv[1].weight, conv[1].bias, shifted, b);
+        shiftedPlanes<CONV2>(b, shifted);
+        conv3x3<CONV2, CONV3>(conv[2].weight, conv[2].bias, shifted, a);
+        shiftedPlanes<CONV3>(a, shifted);
+        conv3x3<CONV3, CONV4>(conv[3].weight, conv[3].bias, shifted, b);
+
+        // Channel major activations are the flattening order of x.view({-1, 512 * 8 * 8})
+        gemv<CONV4 * SQUARES, FC1, true>(fc[0].weight, fc[0].bias, b, a);
+        gemv<FC1, FC2, true>(fc[1].weight, fc[1].bias, a, b);
+        return std::tanh(dot<FC2>(fc[2].weight, b) + fc[2].bias[0]);
+    }
+
+    void Network::refresh(Accumulator &accumulator, const std::uint64_t pieces[12], int perspective) const
+    {
+        float *acc = accumulator.values[perspective];
+        for (int square = 0; square < SQUARES; square++)
+        {
+            std::memcpy(acc + square * CONV1, conv[0].bias, sizeof(float) * CONV1);
+        }
+        for (int board = 0; board < 12; board++)
+        {
+            const float *taps = conv1_taps.data() + planeOf(board, perspective) * 9 * CONV1;
+            for (std::uint64_t bits = pieces[board]; bits != 0; bits &= bits - 1)
+            {
+                applyPiece<true>(acc, taps, __builtin_ctzll(bits) ^ flipOf(perspective));
+            }
+        }
+    }
+
+    void Network::update(const Accumulator &before, Accumulator &after,
+                         const std::uint64_t pieces_before[12], const std::uint64_t pieces_after[12]) const
+    {
+        for (int perspective = WHITE; perspective <= BLACK; perspective++)
+        {
+            float *acc = after.values[perspective];
+            std::memcpy(acc, before.values[perspective], sizeof(float) * SQUARES * CONV1);
+            for (int board = 0; board < 12; board++)
+            {
+                const float *taps = conv1_taps.data() + planeOf(board, perspective) * 9 * CONV1;
+                for (std::uint64_t bits = pieces_before[board] & ~pieces_after[board]; bits != 0; bits &= bits - 1)
+                {
+                    applyPiece<false>(acc, taps, __builtin_ctzll(bits) ^ flipOf(perspective));
+                }
+                for (std::uint64_t bits = pieces_after[board] & ~pieces_before[board]; bits != 0; bits &= bits - 1)
+                {
+                    applyPiece<true>(acc, taps, __builtin_ctzll(bits) ^ flipOf(perspective));
+                }
+            }
+        }
+    }
+
+    float Network::forward(const Accumulator &accumulator, bool white_to_move, std::uint64_t en_passant) const
+    {
+        Scratch &s = scratch();
+        const int perspective = white_to_move ? WHITE : BLACK;
+
+        // The en passant plane changes with the position, not with the pieces: added to a copy
+        const float *acc = accumulator.values[perspective];
+        if (en_passant != 0)
+        {
+            std::memcpy(s.b.data(), acc, sizeof(float) * SQUARES * CONV1);
+            const float *taps = conv1_taps.data() + (INPUT_PLANES - 1) * 9 * CONV1;
+            for (std::uint64_t bits = en_passant; bits != 0; bits &= bits - 1)
+            {
+                applyPiece<true>(s.b.data(), taps, __builtin_ctzll(bits) ^ flipOf(perspective));
+            }
+            acc = s.b.data();
+        }
+
+        // ReLU, square major to channel major
+        for (int square = 0; square < SQUARES; square++)
+        {
+            for (int ch = 0; ch < CONV1; ch++)
+            {
+                s.a[ch * SQUARES + square] = std::max(acc[square * CONV1 + ch], 0.0f);
+            }
+        }
+        return afterConv1(s.a.data(), s.b.data(), s.shifted.data());
+    }
+}
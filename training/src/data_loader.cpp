@@ -2,11 +2,13 @@
 #include "../include/chessnet.h"
 #include <iostream>
 
-BatchData load_data(sqlite3 *db, int batch_size, int lastRowid, ChessNet net, torch::Device device)
+PositionBatch load_positions(sqlite3 *db, int batch_size, int lastRowid)
 {
-    BatchData batch_data; // Will hold final (inputs, targets) Tensors
-    std::vector<torch::Tensor> inputs;
-    std::vector<torch::Tensor> targets;
+    PositionBatch batch; // Positions and evaluations, not encoded for any network yet
+    std::vector<ChessPosition> &positions = batch.positions;
+    std::vector<float> &targets = batch.targets;
+    positions.reserve(batch_size);
+    targets.reserve(batch_size);
 
     sqlite3_stmt *stmt;
 
@@ -28,7 +30,7 @@ BatchData load_data(sqlite3 *db, int batch_size, int lastRowid, ChessNet net, to
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
     {
         std::cerr << "Failed to prepare SQL statement: " << sqlite3_errmsg(db) << std::endl;
-        return batch_data; // Returns empty BatchData
+        return batch; // Returns empty PositionBatch
     }
 
     // Bind batch size and offset
@@ -125,47 +127,44 @@ BatchData load_data(sqlite3 *db, int batch_size, int lastRowid, ChessNet net, to
         // so flip the evaluatiion around 0 if it's blacks move
         evaluation *= whiteMove ? 1.0f : -1.0f;
 
-        torch::Tensor input_tensor;
-        try
-        {
-            input_tensor = net->toTensor(position);
-        }
-        catch (const std::exception &e)
-        {
-            std::cerr << "Error converting position to tensor: " << e.what() << std::endl;
-            continue; // Skip invalid row
-        }
-
-        input_tensor = input_tensor.unsqueeze(0);
-
-        // Move input_tensor to device (CPU or CUDA)
-        input_tensor = input_tensor.to(device);
-
-        // Collect all input samples
-        inputs.push_back(input_tensor);
-
-        torch::Tensor target_tensor = torch::tensor(evaluation, torch::dtype(torch::kFloat32)).to(device);
-        targets.push_back(target_tensor);
+        // Collect all samples, they are encoded and go to the device as one batch
+        positions.push_back(position);
+        targets.push_back(evaluation);
 
         row_count++;
     }
 
     sqlite3_finalize(stmt);
 
-    // If no rows were fetched, return empty BatchData
+    // If no rows were fetched, return empty PositionBatch
     if (row_count == 0)
     {
         std::cerr << "No data found in database or no valid rows." << std::endl;
-        return batch_data;
+        return batch;
     }
 
-    batch_data.inputs = torch::cat(inputs, /*dim=*/0);
+    std::cout << "last rowid:" <<  lastRowIdCaptured << std::endl;
+
+    batch.last_rowid = lastRowIdCaptured;
 
-    batch_data.targets = torch::stack(targets, /*dim=*/0).squeeze(-1);
+    return batch;
+}
 
-    std::cout << "last rowid:" <<  lastRowIdCaptured << std::endl;
+BatchData load_data(sqlite3 *db, int batch_size, int lastRowid, ChessNet net, torch::Device device)
+{
+    BatchData batch_data; // Will hold final (inputs, targets) Tensors
+    PositionBatch batch = load_positions(db, batch_size, lastRowid);
+    if (batch.positions.empty())
+    {
+        return batch_data;
+    }
+
+    // One copy per batch instead of one per position (NNUEHalfKP inputs are indices, a few hundred bytes each)
+    batch_data.inputs = toBatch(net, batch.positions).to(device);
+
+    batch_data.targets = torch::tensor(batch.targets, torch::dtype(torch::kFloat32)).squeeze(-1).to(device);
 
-    batch_data.last_rowid = lastRowIdCaptured;
+    batch_data.last_rowid = batch.last_rowid;
 
     return batch_data;
 }
\ No newline at end of file
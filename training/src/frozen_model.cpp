@@ -0,0 +1,85 @@
+#include "../include/frozen_model.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char *FINGERPRINT_FILE = "fingerprint";
+
+// TorchScript source of the forward pass, layer l uses the constants w<l> and b<l>
+static std::string forwardSource(const std::vector<FoldedLayer> &layers)
+{
+    std::ostringstream source;
+    source << "def forward(self, x):\n";
+    for (std::size_t l = 0; l < layers.size(); l++)
+    {
+        if (layers[l].kind == FoldedLayer::Conv3x3)
+        {
+            source << "    x = torch.conv2d(x, self.w" << l << ", self.b" << l << ", [1, 1], [1, 1])\n";
+        }
+        else
+        {
+            // Channel major flattening, as x.view({-1, C * 8 * 8}) in the models
+            source << "    x = torch.linear(x.reshape([x.size(0), -1]), self.w" << l << ", self.b" << l << ")\n";
+        }
+        source << (layers[l].relu ? "    x = torch.relu(x)\n" : "    x = torch.tanh(x)\n");
+    }
+    source << "    return x\n";
+    return source.str();
+}
+
+bool exportFrozen(const std::vector<FoldedLayer> &layers, const std::string &path, uint64_t fingerprint)
+{
+    torch::NoGradGuard no_grad;
+    if (layers.empty())
+    {
+        std::cerr << "Error: no layers to freeze" << std::endl;
+        return false;
+    }
+
+    try
+    {
+        torch::jit::Module module("FrozenChessNet");
+        for (std::size_t l = 0; l < layers.size(); l++)
+        {
+            module.register_parameter("w" + std::to_string(l), layers[l].weight.detach().contiguous(), /*is_buffer=*/false);
+            module.register_parameter("b" + std::to_string(l), layers[l].bias.detach().contiguous(), /*is_buffer=*/false);
+        }
+        module.define(forwardSource(layers));
+        module.eval();
+
+        torch::jit::Module frozen = torch::jit::freeze(module);
+        frozen.save(path, {{FINGERPRINT_FILE, std::to_string(fingerprint)}});
+    }
+    catch (const c10::Error &e)
+    {
+        std::cerr << "Error: cannot write frozen model " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadFrozen(const std::string &path, uint64_t fingerprint, torch::Device device, torch::jit::Module &module)
+{
+    if (!std::ifstream(path))
+    {
+        return false;
+    }
+
+    try
+    {
+        torch::jit::ExtraFilesMap extra{{FINGERPRINT_FILE, ""}};
+        torch::jit::Module loaded = torch::jit::load(path, device, extra);
+        if (extra[FINGERPRINT_FILE] != std::to_string(fingerprint))
+        {
+            return false; // Frozen from other weights
+        }
+        loaded.eval();
+        module = std::move(loaded);
+    }
+    catch (const c10::Error &e)
+    {
+        std::cerr << "Error: cannot load frozen model " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
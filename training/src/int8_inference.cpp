@@ -0,0 +1,203 @@
+#include "../include/int8_inference.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/int8_kernels.h"
+
+namespace Int8Inference
+{
+    static inline std::uint8_t quantize(float x, float inverse_scale, std::int32_t zero)
+    {
+        const int q = static_cast<int>(std::lrint(x * inverse_scale)) + zero;
+        return static_cast<std::uint8_t>(std::clamp(q, 0, QUANT_MAX));
+    }
+
+    // ------------------------------------------
+    // Network
+    // ------------------------------------------
+    Network::~Network()
+    {
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mapped_bytes);
+        }
+    }
+
+    bool Network::load(const std::string &path, std::uint64_t fingerprint)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        FileHeader header;
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < HEADER_BYTES ||
+            pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.fingerprint != fingerprint)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        const std::size_t bytes = static_cast<std::size_t>(st.st_size);
+        void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Error: failed to mmap quantized network " << path << std::endl;
+            return false;
+        }
+
+        // Walk the layers, checking every one fits in the file and feeds the next
+        const auto *base = static_cast<const unsigned char *>(map);
+        std::size_t offset = HEADER_BYTES;
+        std::size_t features = header.input_size;
+        std::vector<Layer> parsed(header.layer_count);
+        std::size_t activation = 0, input = 0;
+        bool valid = header.layer_count > 0;
+        for (auto &layer : parsed)
+        {
+            if (!valid || offset + DESCRIPTOR_BYTES > bytes)
+            {
+                valid = false;
+                break;
+            }
+            std::memcpy(&layer.shape, base + offset, sizeof(LayerDescriptor));
+            const LayerDescriptor &d = layer.shape;
+            const bool conv = d.kind == CONV3X3;
+            const std::size_t weights = static_cast<std::size_t>(d.out) * d.k_padded;
+            const std::size_t block = padded(weights + 2 * sizeof(float) * d.out);
+            if ((d.kind != CONV3X3 && d.kind != LINEAR) || d.k != (conv ? d.in * 9 : d.in) ||
+                d.k_padded < d.k || d.k_padded % K_ALIGN != 0 || (conv ? d.in * 64 : d.in) != features ||
+                offset + DESCRIPTOR_BYTES + block > bytes)
+            {
+                valid = false;
+                break;
+            }
+            offset += DESCRIPTOR_BYTES;
+            layer.weight = reinterpret_cast<const std::int8_t *>(base + offset);
+            layer.weight_scale = reinterpret_cast<const float *>(base + offset + weights);
+            layer.bias = layer.weight_scale + d.out;
+            offset += block;
+
+            layer.row_sum.resize(d.out);
+            for (std::size_t o = 0; o < d.out; o++)
+            {
+                std::int32_t sum = 0;
+                for (std::size_t i = 0; i < d.k_padded; i++)
+                {
+                    sum += layer.weight[o * d.k_padded + i];
+                }
+                layer.row_sum[o] = sum;
+            }
+
+            features = conv ? static_cast<std::size_t>(d.out) * 64 : d.out;
+            activation = std::max(activation, features);
+            input = std::max(input, conv ? static_cast<std::size_t>(64) * d.k_padded : d.k_padded);
+        }
+        if (!valid || features != 1)
+        {
+            std::cerr << "Error: quantized network " << path << " is damaged" << std::endl;
+            munmap(map, bytes);
+            return false;
+        }
+
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mapped_bytes);
+        }
+        mapping = map;
+        mapped_bytes = bytes;
+        input_size = header.input_size;
+        largest_activation = activation;
+        largest_input = input;
+        layers = std::move(parsed);
+        return true;
+    }
+
+    float Network::forward(const float *input) const
+    {
+        thread_local std::vector<float> a, b;
+        thread_local std::vector<std::uint8_t> quantized, columns;
+        thread_local std::vector<std::int32_t> acc;
+        const std::size_t activation = std::max(largest_activation, input_size);
+        if (a.size() < activation)
+        {
+            a.resize(activation);
+            b.resize(activation);
+            acc.resize(activation);
+        }
+        if (columns.size() < largest_input)
+        {
+            quantized.resize(largest_input);
+            columns.resize(largest_input);
+        }
+
+        const float *x = input;
+        float *y = a.data();
+        for (const Layer &layer : layers)
+        {
+            const LayerDescriptor &d = layer.shape;
+            const float inverse_scale = 1.0f / d.input_scale;
+            const std::uint8_t zero = static_cast<std::uint8_t>(d.input_zero);
+            const std::size_t positions = d.kind == CONV3X3 ? 64 : 1;
+
+            if (d.kind == CONV3X3)
+            {
+                // Quantized planes, then one column of k_padded inputs per square: tap t of
+                // input channel i at i * 9 + t, the zero point (a real 0) off the board
+                std::uint8_t *planes = quantized.data();
+                for (std::size_t i = 0; i < static_cast<std::size_t>(d.in) * 64; i++)
+                {
+                    planes[i] = quantize(x[i], inverse_scale, d.input_zero);
+                }
+                for (int square = 0; square < 64; square++)
+                {
+                    std::uint8_t *column = columns.data() + square * d.k_padded;
+                    const int row = square / 8, col = square % 8;
+                    for (std::size_t i = 0; i < d.in; i++)
+                    {
+                        for (int tap = 0; tap < 9; tap++)
+                        {
+                            const int r = row + tap / 3 - 1;
+                            const int c = col + tap % 3 - 1;
+                            column[i * 9 + tap] = (r >= 0 && r < 8 && c >= 0 && c < 8) ? planes[i * 64 + r * 8 + c] : zero;
+                        }
+                    }
+                    std::memset(column + d.k, 0, d.k_padded - d.k);
+                }
+            }
+            else
+            {
+                std::uint8_t *column = columns.data();
+                for (std::size_t i = 0; i < d.k; i++)
+                {
+                    column[i] = quantize(x[i], inverse_scale, d.input_zero);
+                }
+                std::memset(column + d.k, 0, d.k_padded - d.k);
+            }
+
+            // Output o at square s is out[o * positions + s], the channel major layout of torch
+            for (std::size_t s = 0; s < positions; s++)
+            {
+                Int8Kernels::gemv(layer.weight, d.out, d.k_padded, columns.data() + s * d.k_padded, acc.data());
+                for (std::size_t o = 0; o < d.out; o++)
+                {
+                    const std::int32_t sum = acc[o] - d.input_zero * layer.row_sum[o];
+                    const float value = layer.weight_scale[o] * d.input_scale * static_cast<float>(sum) + layer.bias[o];
+                    y[o * positions + s] = d.relu ? std::max(value, 0.0f) : std::tanh(value);
+                }
+            }
+
+            x = y;
+            y = (y == a.data()) ? b.data() : a.data();
+        }
+        return x[0];
+    }
+}
@@ -4,13 +4,28 @@
 #include <fstream> // For file output
 #include <vector>  // For storing losses
 #include <cmath>   // For std::sqrt
+#include <type_traits>
 #include "../include/chessnet.h"
 #include "../include/data_loader.h"
+#include "../include/int8_inference.h"
+#include "../include/nnue_inference.h"
+#include "../include/quantization.h"
 
 //-------------------------------------------------
 // Utility to save the model to disk
 //-------------------------------------------------
-void save_model(ChessNet &net, const torch::Device &device, const std::string &path)
+// The engine runs the HalfKP network from its own quantized file, the other networks from the .pt
+template <class Net>
+void export_for_engine(Net &net)
+{
+    if constexpr (std::is_same_v<Net, NNUEHalfKP>)
+    {
+        net->exportQuantized("../NN_weights/nnue_halfkp.bin");
+    }
+}
+
+template <class Net>
+void save_model(Net &net, const torch::Device &device, const std::string &path)
 {
     torch::serialize::OutputArchive output_archive;
     net->to(torch::kCPU); // Move model to CPU for saving
@@ -155,7 +170,347 @@ BatchMetrics evaluate_on_validation_set(
     return aggregator.compute_metrics();
 }
 
-int main()
+//-------------------------------------------------
+// Distillation (./training --distill): NNUEHalfKP learns
+// the outputs of the trained ChessNetConv. The engine only
+// evaluates leaves with its export when MASALOT_NNUE names
+// the file. The accuracy side of the trade-off goes to
+// distill_metrics.csv every epoch, the speed side is
+// printed at the end.
+//-------------------------------------------------
+const char *TEACHER_PATH = "../NN_weights/model_V1.5_C_FV_vlack_andwhite_evals_scaled_10e_weighted_lr_1e4_final.pt";
+const float TEACHER_WEIGHT = 0.8f; // Student target = TEACHER_WEIGHT * teacher + (1 - TEACHER_WEIGHT) * eval_scaled
+
+struct DistillMetrics
+{
+    BatchMetrics student;      // Student against eval_scaled
+    BatchMetrics teacher;      // Teacher against eval_scaled
+    float student_teacher_mse; // How closely the student follows the teacher
+};
+
+// Student and teacher over the validation rows
+DistillMetrics evaluate_distillation(
+    ChessNetConv &teacher,
+    NNUEHalfKP &student,
+    sqlite3 *db,
+    int64_t validation_dataset_size,
+    int64_t batch_size,
+    torch::Device device)
+{
+    student->eval();
+    torch::NoGradGuard no_grad;
+
+    Aggregator student_aggregator, teacher_aggregator;
+    double sum_sq_gap = 0.0;
+    int64_t samples = 0;
+    int64_t val_last_rowid = 10'363'868;
+    for (int64_t i = 0; i < validation_dataset_size / batch_size; ++i)
+    {
+        PositionBatch rows = load_positions(db, batch_size, val_last_rowid);
+        if (rows.positions.empty())
+            break;
+        val_last_rowid = rows.last_rowid;
+
+        auto targets = torch::tensor(rows.targets, torch::kFloat32).to(device);
+        auto teacher_out = teacher->forward(toBatch(teacher, rows.positions).to(device)).reshape({-1});
+        auto student_out = student->forward(toBatch(student, rows.positions).to(device)).reshape({-1});
+        student_aggregator.add_batch(student_out, targets);
+        teacher_aggregator.add_batch(teacher_out, targets);
+        sum_sq_gap += torch::sum(torch::pow(student_out - teacher_out, 2)).item<double>();
+        samples += targets.size(0);
+    }
+
+    student->train();
+    return {student_aggregator.compute_metrics(), teacher_aggregator.compute_metrics(),
+            samples > 0 ? static_cast<float>(sum_sq_gap / samples) : 0.0f};
+}
+
+// Microseconds per position, one libtorch forward pass at batch size 1
+template <class Net>
+double forward_latency_us(Net &net, const std::vector<ChessPosition> &positions, torch::Device device)
+{
+    c10::InferenceMode inference;
+    net->forward(net->toTensor(positions.front()).unsqueeze(0).to(device)).template item<float>();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto &position : positions)
+    {
+        net->forward(net->toTensor(position).unsqueeze(0).to(device)).template item<float>();
+    }
+    std::chrono::duration<double, std::micro> duration = std::chrono::high_resolution_clock::now() - start;
+    return duration.count() / positions.size();
+}
+
+// Microseconds per position in the engine's NNUE runtime, refreshing both accumulators every
+// time (the search mostly updates them from the parent, which is cheaper)
+double nnue_latency_us(const NNUEInference::Network &network, const std::vector<ChessPosition> &positions)
+{
+    NNUEInference::Accumulator accumulator;
+    volatile float sink = 0.0f;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto &position : positions)
+    {
+        const uint64_t pieces[12] = {
+            position.WPawn, position.WKnight, position.WBishop, position.WRook, position.WQueen, position.WKing,
+            position.BPawn, position.BKnight, position.BBishop, position.BRook, position.BQueen, position.BKing};
+        network.refresh(accumulator, pieces, NNUEInference::WHITE);
+        network.refresh(accumulator, pieces, NNUEInference::BLACK);
+        sink = network.evaluate(accumulator, true); // Normalized positions: white is the side to move
+    }
+    std::chrono::duration<double, std::micro> duration = std::chrono::high_resolution_clock::now() - start;
+    return duration.count() / positions.size();
+}
+
+int distill(sqlite3 *db, torch::Device device, int64_t num_epochs, int64_t batch_size,
+            int64_t training_dataset_size, int64_t validation_dataset_size)
+{
+    // Teacher: the production network, frozen
+    auto teacher = ChessNetConv();
+    try
+    {
+        torch::serialize::InputArchive input_archive;
+        input_archive.load_from(TEACHER_PATH);
+        teacher->load(input_archive);
+    }
+    catch (const c10::Error &e)
+    {
+        std::cerr << "Error loading teacher weights: " << e.what() << std::endl;
+        return 1;
+    }
+    teacher->to(device);
+    teacher->eval();
+
+    auto student = NNUEHalfKP();
+    student->to(device);
+    torch::optim::Adam optimizer(student->parameters(), torch::optim::AdamOptions(1e-3));
+
+    std::ofstream distill_csv("distill_metrics.csv");
+    distill_csv << "epoch,"
+                << "student_mse,student_mae,student_r2,"
+                << "teacher_mse,teacher_mae,teacher_r2,"
+                << "student_teacher_mse\n";
+
+    const int64_t num_batches = training_dataset_size / batch_size;
+    float best_gap = std::numeric_limits<float>::max();
+    for (int epoch = 0; epoch < num_epochs; ++epoch)
+    {
+        int64_t last_rowid = 0;
+        for (int batch_idx = 0; batch_idx < num_batches; ++batch_idx)
+        {
+            PositionBatch rows = load_positions(db, batch_size, last_rowid);
+            if (rows.positions.empty())
+            {
+                std::cerr << "No more training rows found.\n";
+                break;
+            }
+            last_rowid = rows.last_rowid;
+
+            // Soft targets from the teacher, a little of the data's own evaluation kept in
+            torch::Tensor target;
+            {
+                torch::NoGradGuard no_grad;
+                auto teacher_out = teacher->forward(toBatch(teacher, rows.positions).to(device)).reshape({-1});
+                auto evals = torch::tensor(rows.targets, torch::kFloat32).to(device);
+                target = TEACHER_WEIGHT * teacher_out + (1.0f - TEACHER_WEIGHT) * evals;
+            }
+
+            optimizer.zero_grad();
+            auto output = student->forward(toBatch(student, rows.positions).to(device)).reshape({-1});
+            auto loss = torch::mse_loss(output, target);
+            loss.backward();
+            optimizer.step();
+
+            if ((batch_idx + 1) % 100 == 0)
+            {
+                std::cout << "Distill epoch [" << (epoch + 1) << " / " << num_epochs << "]  Batch [" << (batch_idx + 1)
+                          << "/" << num_batches << "]  MSE to target: " << loss.item<float>() << "\n";
+            }
+        }
+
+        auto metrics = evaluate_distillation(teacher, student, db, validation_dataset_size, batch_size, device);
+        std::cout << "[Distill epoch " << (epoch + 1) << "] "
+                  << "Student Val MSE=" << metrics.student.mse << ", R2=" << metrics.student.r2 << " || "
+                  << "Teacher Val MSE=" << metrics.teacher.mse << ", R2=" << metrics.teacher.r2 << " || "
+                  << "Student to teacher MSE=" << metrics.student_teacher_mse << std::endl;
+        distill_csv << (epoch + 1) << ","
+                    << metrics.student.mse << "," << metrics.student.mae << "," << metrics.student.r2 << ","
+                    << metrics.teacher.mse << "," << metrics.teacher.mae << "," << metrics.teacher.r2 << ","
+                    << metrics.student_teacher_mse << "\n";
+
+        // The closest student so far is exported, the engine plays with it when MASALOT_NNUE points at it
+        if (metrics.student_teacher_mse < best_gap)
+        {
+            best_gap = metrics.student_teacher_mse;
+            save_model(student, device, "../NN_weights/student_nnue.pt");
+            export_for_engine(student);
+        }
+    }
+
+    // Speed side of the trade-off, on validation positions
+    PositionBatch sample = load_positions(db, 256, 10'363'868);
+    if (!sample.positions.empty())
+    {
+        student->eval();
+        std::cout << "Teacher (libtorch, batch 1): " << forward_latency_us(teacher, sample.positions, device) << " us/position\n"
+                  << "Student (libtorch, batch 1): " << forward_latency_us(student, sample.positions, device) << " us/position\n";
+        NNUEInference::Network runtime;
+        if (runtime.load("../NN_weights/nnue_halfkp.bin"))
+        {
+            std::cout << "Student (engine NNUE, full refresh): " << nnue_latency_us(runtime, sample.positions) << " us/position\n";
+        }
+    }
+    distill_csv.close();
+    return 0;
+}
+
+//-------------------------------------------------
+// Quantization aware training (./training --qat): fine-tunes
+// the folded network the engine plays with under fake int8
+// quantization and writes the int8 file the engine loads.
+//-------------------------------------------------
+const char *QAT_MODEL_PATH = "../NN_weights/model_V1.5_C_FV_vlack_andwhite_evals_scaled_10e_weighted_lr_1e4_final.pt";
+const char *QAT_INT8_DIR = "../NN_weights"; // The file is named by the fingerprint of the source model
+const int64_t QAT_EPOCHS = 2;
+const int64_t QAT_CALIBRATION_BATCHES = 16; // Seed the input ranges before the first validation
+const double QAT_LEARNING_RATE = 1e-5;
+
+struct QATMetrics
+{
+    BatchMetrics float_forward; // Same weights, no quantization
+    BatchMetrics int8_forward;  // Fake quantized, what the engine's int8 kernel computes
+};
+
+template <class Net>
+QATMetrics evaluate_qat(QATNet &qat, Net &net, sqlite3 *db, int64_t validation_dataset_size,
+                        int64_t batch_size, torch::Device device)
+{
+    qat->eval();
+    torch::NoGradGuard no_grad;
+
+    Aggregator float_aggregator, int8_aggregator;
+    int64_t val_last_rowid = 10'363'868;
+    for (int64_t i = 0; i < validation_dataset_size / batch_size; ++i)
+    {
+        BatchData batch_data = load_data(db, batch_size, val_last_rowid, net, device);
+        val_last_rowid = batch_data.last_rowid;
+        if (batch_data.inputs.size(0) == 0)
+            break;
+
+        float_aggregator.add_batch(qat->forwardFloat(batch_data.inputs), batch_data.targets);
+        int8_aggregator.add_batch(qat->forward(batch_data.inputs), batch_data.targets);
+    }
+
+    qat->train();
+    return {float_aggregator.compute_metrics(), int8_aggregator.compute_metrics()};
+}
+
+template <class Net>
+int quantization_aware_training(sqlite3 *db, torch::Device device, int64_t batch_size,
+                                int64_t training_dataset_size, int64_t validation_dataset_size)
+{
+    if constexpr (std::is_same_v<Net, NNUEHalfKP>)
+    {
+        std::cerr << "NNUEHalfKP has no folded network, exportQuantized writes its int8 file" << std::endl;
+        return 1;
+    }
+    else
+    {
+        auto net = Net();
+        try
+        {
+            torch::serialize::InputArchive input_archive;
+            input_archive.load_from(QAT_MODEL_PATH);
+            net->load(input_archive);
+        }
+        catch (const c10::Error &e)
+        {
+            std::cerr << "Error loading model weights: " << e.what() << std::endl;
+            return 1;
+        }
+        net->to(device);
+        net->eval();
+        const uint64_t fingerprint = weightsFingerprint(*net); // The engine finds the int8 file by its float model
+        const std::string int8_path = Int8Inference::filePath(QAT_INT8_DIR, fingerprint);
+
+        auto qat = QATNet(net->foldedLayers());
+        qat->to(device);
+        torch::optim::Adam optimizer(qat->parameters(), torch::optim::AdamOptions(QAT_LEARNING_RATE));
+
+        // Input ranges from the first training batches, before any weight moves
+        int64_t last_rowid = 0;
+        {
+            torch::NoGradGuard no_grad;
+            for (int64_t i = 0; i < QAT_CALIBRATION_BATCHES; ++i)
+            {
+                BatchData batch_data = load_data(db, batch_size, last_rowid, net, device);
+                last_rowid = batch_data.last_rowid;
+                if (batch_data.inputs.size(0) > 0)
+                {
+                    qat->forward(batch_data.inputs);
+                }
+            }
+        }
+
+        std::ofstream qat_csv("qat_metrics.csv");
+        qat_csv << "epoch,"
+                << "float_mse,float_mae,float_r2,"
+                << "int8_mse,int8_mae,int8_r2\n";
+        auto report = [&](int64_t epoch)
+        {
+            QATMetrics metrics = evaluate_qat(qat, net, db, validation_dataset_size, batch_size, device);
+            std::cout << "[QAT epoch " << epoch << "] "
+                      << "Float Val MSE=" << metrics.float_forward.mse << ", R2=" << metrics.float_forward.r2 << " || "
+                      << "Int8 Val MSE=" << metrics.int8_forward.mse << ", R2=" << metrics.int8_forward.r2 << std::endl;
+            qat_csv << epoch << ","
+                    << metrics.float_forward.mse << "," << metrics.float_forward.mae << "," << metrics.float_forward.r2 << ","
+                    << metrics.int8_forward.mse << "," << metrics.int8_forward.mae << "," << metrics.int8_forward.r2 << "\n";
+            return metrics;
+        };
+
+        // Epoch 0 is the trained model as post-training quantization sees it
+        float best_int8_mse = report(0).int8_forward.mse;
+        qat->exportInt8(int8_path, fingerprint);
+
+        const int64_t num_batches = training_dataset_size / batch_size;
+        for (int64_t epoch = 1; epoch <= QAT_EPOCHS; ++epoch)
+        {
+            last_rowid = 0;
+            for (int64_t batch_idx = 0; batch_idx < num_batches; ++batch_idx)
+            {
+                BatchData batch_data = load_data(db, batch_size, last_rowid, net, device);
+                if (batch_data.inputs.size(0) == 0)
+                {
+                    std::cerr << "No more training rows found.\n";
+                    break;
+                }
+                last_rowid = batch_data.last_rowid;
+
+                optimizer.zero_grad();
+                auto output = qat->forward(batch_data.inputs).reshape({-1});
+                auto loss = torch::mse_loss(output, batch_data.targets.reshape({-1}));
+                loss.backward();
+                optimizer.step();
+
+                if ((batch_idx + 1) % 100 == 0)
+                {
+                    std::cout << "QAT epoch [" << epoch << " / " << QAT_EPOCHS << "]  Batch [" << (batch_idx + 1)
+                              << "/" << num_batches << "]  Loss: " << loss.item<float>() << "\n";
+                }
+            }
+
+            QATMetrics metrics = report(epoch);
+            if (metrics.int8_forward.mse < best_int8_mse)
+            {
+                best_int8_mse = metrics.int8_forward.mse;
+                qat->exportInt8(int8_path, fingerprint);
+                std::cout << "Int8 model written to " << int8_path << std::endl;
+            }
+        }
+        qat_csv.close();
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
 {
     // -----------------------------
     // Device setup
@@ -196,6 +551,19 @@ int main()
 
     const int64_t num_batches = training_dataset_size / batch_size;
 
+    if (argc > 1 && std::string(argv[1]) == "--distill")
+    {
+        int result = distill(db, device, num_epochs, batch_size, training_dataset_size, validation_dataset_size);
+        sqlite3_close(db);
+        return result;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--qat")
+    {
+        int result = quantization_aware_training<ChessNet>(db, device, batch_size, training_dataset_size, validation_dataset_size);
+        sqlite3_close(db);
+        return result;
+    }
+
     float min_loss = std::numeric_limits<float>::max();
     float best_val_loss = std::numeric_limits<float>::max();
 
@@ -408,6 +776,7 @@ int main()
     // Save final model
     // -----------------------------
     save_model(net, device, "../NN_weights/model_last.pt");
+    export_for_engine(net);
 
     // Close CSVs & DB
     epoch_csv.close();
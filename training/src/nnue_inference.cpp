@@ -0,0 +1,259 @@
+#include "../include/nnue_inference.h"
+#include "../include/int8_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace NNUEInference
+{
+    // ------------------------------------------
+    // Features
+    // ------------------------------------------
+    int activeFeatures(const std::uint64_t pieces[12], int perspective, std::uint32_t *out)
+    {
+        const int flip = perspective == WHITE ? 0 : 56;
+        const int king = __builtin_ctzll(pieces[perspective == WHITE ? 5 : 11]) ^ flip;
+        int count = 0;
+        for (int color = WHITE; color <= BLACK; color++)
+        {
+            for (int type = 0; type < 5; type++)
+            {
+                const int kind = type + (color == perspective ? 0 : 5);
+                for (std::uint64_t bits = pieces[color * 6 + type]; bits != 0 && count < MAX_ACTIVE; bits &= bits - 1)
+                {
+                    out[count++] = featureIndex(king, kind, __builtin_ctzll(bits) ^ flip);
+                }
+            }
+        }
+        return count;
+    }
+
+    // ------------------------------------------
+    // Accumulator columns, HIDDEN int16 at a time
+    // ------------------------------------------
+#if defined(__AVX512BW__)
+    static inline void addColumn(std::int16_t *acc, const std::int16_t *column)
+    {
+        for (int i = 0; i < HIDDEN; i += 32)
+        {
+            _mm512_store_si512(acc + i, _mm512_add_epi16(_mm512_load_si512(acc + i), _mm512_loadu_si512(column + i)));
+        }
+    }
+
+    static inline void subColumn(std::int16_t *acc, const std::int16_t *column)
+    {
+        for (int i = 0; i < HIDDEN; i += 32)
+        {
+            _mm512_store_si512(acc + i, _mm512_sub_epi16(_mm512_load_si512(acc + i), _mm512_loadu_si512(column + i)));
+        }
+    }
+#elif defined(__AVX2__)
+    static inline void addColumn(std::int16_t *acc, const std::int16_t *column)
+    {
+        for (int i = 0; i < HIDDEN; i += 16)
+        {
+            auto *a = reinterpret_cast<__m256i *>(acc + i);
+            _mm256_store_si256(a, _mm256_add_epi16(_mm256_load_si256(a), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(column + i))));
+        }
+    }
+
+    static inline void subColumn(std::int16_t *acc, const std::int16_t *column)
+    {
+        for (int i = 0; i < HIDDEN; i += 16)
+        {
+            auto *a = reinterpret_cast<__m256i *>(acc + i);
+            _mm256_store_si256(a, _mm256_sub_epi16(_mm256_load_si256(a), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(column + i))));
+        }
+    }
+#else
+    static inline void addColumn(std::int16_t *acc, const std::int16_t *column)
+    {
+        for (int i = 0; i < HIDDEN; i++)
+        {
+            acc[i] = static_cast<std::int16_t>(acc[i] + column[i]);
+        }
+    }
+
+    static inline void subColumn(std::int16_t *acc, const std::int16_t *column)
+    {
+        for (int i = 0; i < HIDDEN; i++)
+        {
+            acc[i] = static_cast<std::int16_t>(acc[i] - column[i]);
+        }
+    }
+#endif
+
+    // ------------------------------------------
+    // Network
+    // ------------------------------------------
+    static constexpr int paddedK(int k) { return (k + DENSE_K_ALIGN - 1) / DENSE_K_ALIGN * DENSE_K_ALIGN; }
+
+    static constexpr std::size_t denseBytes(int in, int out)
+    {
+        return static_cast<std::size_t>(out) * paddedK(in) + 2 * sizeof(float) * out;
+    }
+
+    std::size_t bodyBytes()
+    {
+        return sizeof(std::int16_t) * HIDDEN * (1 + static_cast<std::size_t>(HALFKP_FEATURES)) +
+               denseBytes(2 * HIDDEN, FC1) + denseBytes(FC1, FC2) + sizeof(float) * (FC2 + 1);
+    }
+
+    Network::~Network()
+    {
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mapped_bytes);
+        }
+    }
+
+    bool Network::load(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        const std::size_t bytes = HEADER_BYTES + bodyBytes();
+        struct stat st;
+        char magic[8];
+        std::uint32_t shape[4];
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != bytes ||
+            pread(fd, magic, 8, 0) != 8 || pread(fd, shape, sizeof(shape), 8) != static_cast<ssize_t>(sizeof(shape)) ||
+            std::memcmp(magic, FILE_MAGIC, 8) != 0 || shape[0] != HALFKP_FEATURES || shape[1] != HIDDEN ||
+            shape[2] != FC1 || shape[3] != FC2)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Error: failed to mmap NNUE network " << path << std::endl;
+            return false;
+        }
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mapped_bytes);
+        }
+        mapping = map;
+        mapped_bytes = bytes;
+
+        const unsigned char *p = static_cast<const unsigned char *>(map) + HEADER_BYTES;
+        ft_bias = reinterpret_cast<const std::int16_t *>(p);
+        ft_weight = ft_bias + HIDDEN;
+        p += sizeof(std::int16_t) * HIDDEN * (1 + static_cast<std::size_t>(HALFKP_FEATURES));
+        auto take = [&p](Dense &layer, int in, int out)
+        {
+            layer.in = in;
+            layer.out = out;
+            layer.k_padded = paddedK(in);
+            layer.weight = reinterpret_cast<const std::int8_t *>(p);
+            layer.scale = reinterpret_cast<const float *>(p + static_cast<std::size_t>(out) * layer.k_padded);
+            layer.bias = layer.scale + out;
+            p += denseBytes(in, out);
+        };
+        take(fc1, 2 * HIDDEN, FC1);
+        take(fc2, FC1, FC2);
+        out_weight = reinterpret_cast<const float *>(p);
+        out_bias = out_weight + FC2;
+        return true;
+    }
+
+    void Network::refresh(Accumulator &accumulator, const std::uint64_t pieces[12], int perspective) const
+    {
+        std::int16_t *acc = accumulator.values[perspective];
+        std::memcpy(acc, ft_bias, sizeof(std::int16_t) * HIDDEN);
+        std::uint32_t features[MAX_ACTIVE];
+        const int count = activeFeatures(pieces, perspective, features);
+        for (int i = 0; i < count; i++)
+        {
+            addColumn(acc, ft_weight + static_cast<std::size_t>(features[i]) * HIDDEN);
+        }
+    }
+
+    void Network::update(const Accumulator &before, Accumulator &after,
+                         const std::uint64_t pieces_before[12], const std::uint64_t pieces_after[12]) const
+    {
+        for (int perspective = WHITE; perspective <= BLACK; perspective++)
+        {
+            const int king_index = perspective == WHITE ? 5 : 11;
+            if (pieces_before[king_index] != pieces_after[king_index])
+            {
+                refresh(after, pieces_after, perspective); // Every feature depends on the king square
+                continue;
+            }
+
+            std::int16_t *acc = after.values[perspective];
+            std::memcpy(acc, before.values[perspective], sizeof(std::int16_t) * HIDDEN);
+            const int flip = perspective == WHITE ? 0 : 56;
+            const int king = __builtin_ctzll(pieces_after[king_index]) ^ flip;
+            for (int color = WHITE; color <= BLACK; color++)
+            {
+                for (int type = 0; type < 5; type++)
+                {
+                    const int board = color * 6 + type;
+                    const int kind = type + (color == perspective ? 0 : 5);
+                    for (std::uint64_t bits = pieces_before[board] & ~pieces_after[board]; bits != 0; bits &= bits - 1)
+                    {
+                        subColumn(acc, ft_weight + static_cast<std::size_t>(featureIndex(king, kind, __builtin_ctzll(bits) ^ flip)) * HIDDEN);
+                    }
+                    for (std::uint64_t bits = pieces_after[board] & ~pieces_before[board]; bits != 0; bits &= bits - 1)
+                    {
+                        addColumn(acc, ft_weight + static_cast<std::size_t>(featureIndex(king, kind, __builtin_ctzll(bits) ^ flip)) * HIDDEN);
+                    }
+                }
+            }
+        }
+    }
+
+    // Clipped ReLU on a dense layer: float value, then back to 0..127 (1.0 = 127) for the next one
+    static inline std::uint8_t clipped(float value)
+    {
+        return static_cast<std::uint8_t>(std::clamp(static_cast<int>(std::lrint(value * FT_SCALE)), 0, FT_SCALE));
+    }
+
+    float Network::evaluate(const Accumulator &accumulator, bool white_to_move) const
+    {
+        alignas(64) std::uint8_t input[2 * HIDDEN];
+        alignas(64) std::uint8_t hidden1[paddedK(FC1)] = {};
+        alignas(64) std::uint8_t hidden2[FC2];
+        alignas(64) std::int32_t sums[FC1 > FC2 ? FC1 : FC2];
+
+        // Side to move first, as the network was trained on positions seen by the side to move
+        const int order[2] = {white_to_move ? WHITE : BLACK, white_to_move ? BLACK : WHITE};
+        for (int half = 0; half < 2; half++)
+        {
+            const std::int16_t *acc = accumulator.values[order[half]];
+            for (int i = 0; i < HIDDEN; i++)
+            {
+                input[half * HIDDEN + i] = static_cast<std::uint8_t>(std::clamp<int>(acc[i], 0, FT_SCALE));
+            }
+        }
+
+        Int8Kernels::gemv(fc1.weight, fc1.out, fc1.k_padded, input, sums);
+        for (int o = 0; o < FC1; o++)
+        {
+            hidden1[o] = clipped(fc1.scale[o] * sums[o] / FT_SCALE + fc1.bias[o]);
+        }
+        Int8Kernels::gemv(fc2.weight, fc2.out, fc2.k_padded, hidden1, sums);
+        for (int o = 0; o < FC2; o++)
+        {
+            hidden2[o] = clipped(fc2.scale[o] * sums[o] / FT_SCALE + fc2.bias[o]);
+        }
+
+        float value = *out_bias;
+        for (int i = 0; i < FC2; i++)
+        {
+            value += out_weight[i] * hidden2[i] / FT_SCALE;
+        }
+        return std::tanh(value);
+    }
+}
@@ -0,0 +1,231 @@
+#include "../include/quantization.h"
+#include "../include/int8_inference.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static torch::Tensor applyLayer(const FoldedLayer &layer, torch::Tensor x)
+{
+    if (layer.kind == FoldedLayer::Conv3x3)
+    {
+        x = torch::conv2d(x, layer.weight, layer.bias, /*stride=*/1, /*padding=*/1);
+    }
+    else
+    {
+        x = torch::linear(x.reshape({x.size(0), -1}), layer.weight, layer.bias);
+    }
+    return layer.relu ? torch::relu(x) : torch::tanh(x);
+}
+
+torch::Tensor foldedForward(const std::vector<FoldedLayer> &layers, torch::Tensor x)
+{
+    torch::NoGradGuard no_grad;
+    for (const auto &layer : layers)
+    {
+        x = applyLayer(layer, x);
+    }
+    return x;
+}
+
+bool quantizeInt8(const std::vector<FoldedLayer> &layers, const std::vector<torch::Tensor> &calibration,
+                  const std::string &path, uint64_t fingerprint)
+{
+    torch::NoGradGuard no_grad;
+    if (layers.empty() || calibration.empty())
+    {
+        std::cerr << "Error: nothing to quantize" << std::endl;
+        return false;
+    }
+
+    // 1. Input range of every layer, batch minimum and maximum averaged over the batches
+    std::vector<double> low(layers.size(), 0.0), high(layers.size(), 0.0);
+    for (const auto &batch : calibration)
+    {
+        torch::Tensor x = batch.to(layers.front().weight.device(), torch::kFloat32);
+        for (std::size_t l = 0; l < layers.size(); l++)
+        {
+            low[l] += x.min().item<double>() / calibration.size();
+            high[l] += x.max().item<double>() / calibration.size();
+            x = applyLayer(layers[l], x);
+        }
+    }
+    return writeInt8(layers, low, high, path, fingerprint);
+}
+
+// Input scale and zero point of a layer from the range of its input, a real 0 must be exact
+// (ReLU output, conv padding)
+static void inputQuantization(double low, double high, float &scale, int32_t &zero)
+{
+    const double lo = std::min(low, 0.0);
+    const double hi = std::max(high, 0.0);
+    const double range = hi - lo > 0.0 ? hi - lo : 1.0;
+    scale = static_cast<float>(range / Int8Inference::QUANT_MAX);
+    zero = std::clamp(static_cast<int32_t>(std::lround(-lo / scale)), 0, Int8Inference::QUANT_MAX);
+}
+
+// The same on the device, without reading the range back to the host
+static void inputQuantization(const torch::Tensor &low, const torch::Tensor &high, torch::Tensor &scale, torch::Tensor &zero)
+{
+    torch::Tensor lo = torch::clamp_max(low, 0.0);
+    torch::Tensor range = torch::clamp_min(high, 0.0) - lo;
+    range = torch::where(range > 0, range, torch::ones_like(range));
+    scale = (range / Int8Inference::QUANT_MAX).to(torch::kFloat32);
+    zero = torch::round(-lo / scale).clamp(0, Int8Inference::QUANT_MAX).to(torch::kInt32);
+}
+
+// Per output channel symmetric weight scales, the largest weight of a channel maps to 127
+static torch::Tensor weightScales(const torch::Tensor &rows)
+{
+    torch::Tensor scale = std::get<0>(rows.abs().max(1)) / 127.0f;
+    return torch::where(scale > 0, scale, torch::ones_like(scale));
+}
+
+bool writeInt8(const std::vector<FoldedLayer> &layers, const std::vector<double> &low, const std::vector<double> &high,
+               const std::string &path, uint64_t fingerprint)
+{
+    torch::NoGradGuard no_grad;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Error: cannot write quantized network " << path << std::endl;
+        return false;
+    }
+
+    Int8Inference::FileHeader header{};
+    std::memcpy(header.magic, Int8Inference::FILE_MAGIC, sizeof(Int8Inference::FILE_MAGIC));
+    header.fingerprint = fingerprint;
+    header.layer_count = static_cast<uint32_t>(layers.size());
+    const torch::Tensor &first = layers.front().weight;
+    header.input_size = static_cast<uint32_t>(layers.front().kind == FoldedLayer::Conv3x3 ? first.size(1) * 64 : first.size(1));
+    char block[Int8Inference::HEADER_BYTES] = {};
+    std::memcpy(block, &header, sizeof(header));
+    out.write(block, sizeof(block));
+
+    for (std::size_t l = 0; l < layers.size(); l++)
+    {
+        const FoldedLayer &layer = layers[l];
+        torch::Tensor weight = layer.weight.to(torch::kCPU, torch::kFloat32);
+        torch::Tensor rows = weight.reshape({weight.size(0), -1}).contiguous();
+        const int64_t out_features = rows.size(0);
+        const int64_t k = rows.size(1);
+        const int64_t k_padded = (k + Int8Inference::K_ALIGN - 1) / Int8Inference::K_ALIGN * Int8Inference::K_ALIGN;
+
+        Int8Inference::LayerDescriptor descriptor{};
+        descriptor.kind = layer.kind == FoldedLayer::Conv3x3 ? Int8Inference::CONV3X3 : Int8Inference::LINEAR;
+        descriptor.in = static_cast<uint32_t>(weight.size(1));
+        descriptor.out = static_cast<uint32_t>(out_features);
+        descriptor.relu = layer.relu ? 1 : 0;
+        descriptor.k = static_cast<uint32_t>(k);
+        descriptor.k_padded = static_cast<uint32_t>(k_padded);
+        inputQuantization(low[l], high[l], descriptor.input_scale, descriptor.input_zero);
+
+        torch::Tensor scale = weightScales(rows);
+        torch::Tensor quantized = torch::zeros({out_features, k_padded}, torch::kInt8);
+        quantized.narrow(1, 0, k).copy_(torch::round(rows / scale.unsqueeze(1)).clamp(-127, 127).to(torch::kInt8));
+        torch::Tensor bias = layer.bias.to(torch::kCPU, torch::kFloat32).contiguous();
+
+        char descriptor_block[Int8Inference::DESCRIPTOR_BYTES] = {};
+        std::memcpy(descriptor_block, &descriptor, sizeof(descriptor));
+        out.write(descriptor_block, sizeof(descriptor_block));
+
+        const std::size_t weight_bytes = static_cast<std::size_t>(out_features * k_padded);
+        out.write(reinterpret_cast<const char *>(quantized.data_ptr<int8_t>()), weight_bytes);
+        out.write(reinterpret_cast<const char *>(scale.contiguous().data_ptr<float>()), out_features * sizeof(float));
+        out.write(reinterpret_cast<const char *>(bias.data_ptr<float>()), out_features * sizeof(float));
+        const std::size_t written = weight_bytes + 2 * out_features * sizeof(float);
+        const std::string padding(Int8Inference::padded(written) - written, '\0');
+        out.write(padding.data(), padding.size());
+
+        std::cout << "Layer " << l << ": input scale " << descriptor.input_scale
+                  << ", zero point " << descriptor.input_zero << std::endl;
+    }
+    return out.good();
+}
+
+// ------------------------------------------
+// Quantization aware training
+// ------------------------------------------
+constexpr double RANGE_MOMENTUM = 0.01;
+
+QATNetImpl::QATNetImpl(const std::vector<FoldedLayer> &layers)
+{
+    for (std::size_t l = 0; l < layers.size(); l++)
+    {
+        kinds.push_back(layers[l].kind);
+        relus.push_back(layers[l].relu);
+        weights.push_back(register_parameter("weight" + std::to_string(l), layers[l].weight.detach().clone()));
+        biases.push_back(register_parameter("bias" + std::to_string(l), layers[l].bias.detach().clone()));
+    }
+    const auto options = torch::TensorOptions().dtype(torch::kFloat64).device(layers.front().weight.device());
+    input_low = register_buffer("input_low", torch::zeros({static_cast<int64_t>(layers.size())}, options));
+    input_high = register_buffer("input_high", torch::zeros({static_cast<int64_t>(layers.size())}, options));
+    observed = register_buffer("observed", torch::zeros({1}, options.dtype(torch::kInt64)));
+}
+
+// Ranges, scales and zero points stay tensors on the device of the network: reading one of them
+// with item() would wait for the GPU once per layer and batch
+torch::Tensor QATNetImpl::run(torch::Tensor x, bool quantize)
+{
+    const bool observe = quantize && is_training();
+    const torch::Tensor first = observed[0].eq(0);
+    for (std::size_t l = 0; l < weights.size(); l++)
+    {
+        torch::Tensor weight = weights[l];
+        if (quantize)
+        {
+            auto low = input_low[l], high = input_high[l];
+            if (observe)
+            {
+                torch::NoGradGuard no_grad;
+                torch::Tensor lo = x.min().to(torch::kFloat64);
+                torch::Tensor hi = x.max().to(torch::kFloat64);
+                low.copy_(torch::where(first, lo, low * (1.0 - RANGE_MOMENTUM) + lo * RANGE_MOMENTUM));
+                high.copy_(torch::where(first, hi, high * (1.0 - RANGE_MOMENTUM) + hi * RANGE_MOMENTUM));
+            }
+            torch::Tensor scale, zero;
+            inputQuantization(low, high, scale, zero);
+            x = torch::fake_quantize_per_tensor_affine(x, scale, zero, 0, Int8Inference::QUANT_MAX);
+
+            // Weights rounded to their int8 grid per output channel, the gradient passes straight through
+            torch::Tensor step = weightScales(weight.detach().reshape({weight.size(0), -1}));
+            torch::Tensor zeros = torch::zeros({weight.size(0)}, step.options().dtype(torch::kInt32));
+            weight = torch::fake_quantize_per_channel_affine(weight, step, zeros, 0, -127, 127);
+        }
+        x = applyLayer({kinds[l], weight, biases[l], relus[l]}, x);
+    }
+    if (observe)
+    {
+        observed += 1;
+    }
+    return x;
+}
+
+torch::Tensor QATNetImpl::forward(torch::Tensor x)
+{
+    return run(x, true);
+}
+
+torch::Tensor QATNetImpl::forwardFloat(torch::Tensor x)
+{
+    return run(x, false);
+}
+
+std::vector<FoldedLayer> QATNetImpl::layers()
+{
+    std::vector<FoldedLayer> result;
+    for (std::size_t l = 0; l < weights.size(); l++)
+    {
+        result.push_back({kinds[l], weights[l].detach(), biases[l].detach(), relus[l]});
+    }
+    return result;
+}
+
+bool QATNetImpl::exportInt8(const std::string &path, uint64_t fingerprint)
+{
+    torch::Tensor low = input_low.to(torch::kCPU), high = input_high.to(torch::kCPU);
+    std::vector<double> lows(low.data_ptr<double>(), low.data_ptr<double>() + low.numel());
+    std::vector<double> highs(high.data_ptr<double>(), high.data_ptr<double>() + high.numel());
+    return writeInt8(layers(), lows, highs, path, fingerprint);
+}